@@ -0,0 +1,44 @@
+/*
+ * batch.js:
+ * Solves lists of states with one solveMany() call per chunk, instead of one solveCube() (and a
+ * state transfer) per state. Shared by the page and the solver worker (after wasm.js).
+ */
+
+const BATCH_CHUNK_SIZE = 256;     // states per solveMany() call
+const BATCH_MOVES_PER_STATE = 64; // room reserved for each solution (SOLVE_BUFFER_SIZE in solver.h)
+const UNSOLVED_RECORD = 0xFF;     // solution of an invalid state (see solveStates in tables.cpp)
+
+let batchBuffers = null; // heap addresses of the solveMany() arguments (allocated once)
+
+/*
+ * solveBatchChunk:
+ * Solves up to BATCH_CHUNK_SIZE states of states (an Int16Array holding copies of PocketCube::state
+ * back to back), starting at the state with index first, and appends their solutions (arrays of
+ * turn IDs, or null for invalid states) to solutions. Returns the index of the next state.
+ */
+function solveBatchChunk(states, first, solutions) {
+    if(batchBuffers == null) {
+        batchBuffers = {
+            states: _malloc(BATCH_CHUNK_SIZE * 12),
+            out: _malloc(BATCH_CHUNK_SIZE * BATCH_MOVES_PER_STATE),
+            offsets: _malloc((BATCH_CHUNK_SIZE + 1) * 4)
+        };
+    }
+
+    let n = Math.min(BATCH_CHUNK_SIZE, states.length / 6 - first);
+    new Int16Array(Module.HEAPU8.buffer, batchBuffers.states, n * 6).set(states.subarray(first * 6, (first + n) * 6));
+
+    let numSolved = _solveMany(batchBuffers.states, n, batchBuffers.out,
+                               BATCH_CHUNK_SIZE * BATCH_MOVES_PER_STATE, batchBuffers.offsets);
+
+    let heap = Module.HEAPU8.buffer;
+    let offsets = new Int32Array(heap, batchBuffers.offsets, numSolved + 1);
+    let out = new Uint8Array(heap, batchBuffers.out, offsets[numSolved]);
+
+    for(let i = 0; i < numSolved; i++) {
+        let moves = out.subarray(offsets[i], offsets[i + 1]);
+        solutions.push(moves.length == 1 && moves[0] == UNSOLVED_RECORD ? null : Array.from(moves));
+    }
+
+    return first + numSolved;
+}
@@ -0,0 +1,586 @@
+#include "solver.h"
+
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <sys/resource.h>
+
+/*
+ * pocket-cube: command-line tools built on the solver core.
+ *
+ *   pocket-cube scramble [-n count] [-d depth] [--seed S] [--threads T]
+ *       prints count optimal scrambles of uniformly random states (exactly depth turns from
+ *       solved, if given), one per line, in move-name notation
+ *
+ *   pocket-cube order <moves>
+ *       prints the order of the move sequence (how many repetitions return to the start) and the
+ *       lengths of its sticker cycles
+ *
+ *   pocket-cube apply <moves> [-k repetitions] [--state S]
+ *       prints the state (as in PocketCube::toString) reached by applying the move sequence k
+ *       times (default 1; negative k applies the inverse) to S (default solved)
+ *
+ *   pocket-cube encode <output> [--stickers | --solutions]
+ *       converts text from stdin into a binary file (see Binary Records in solver.h): states (one
+ *       per line, as in PocketCube::parse) as ranks, or as raw stickers, or solutions (move names)
+ *
+ *   pocket-cube decode <input>
+ *       prints a binary state or solution file as text (unsolved records print as "ERR unsolved",
+ *       and records that can't be states as "ERR invalid record"); fails if the file is truncated
+ *
+ *   pocket-cube solve-batch <input> <output> [--threads T]
+ *       solves every state of a binary state file, writing a binary solution file
+ *
+ *   pocket-cube solve-goal <goal> [--threads T]
+ *       for each state on stdin (one per line), prints a shortest sequence of moves that reaches
+ *       the goal (see Goal in solver.h; e.g. "????????????????????WWWW" for a solved white face),
+ *       or "ERR <reason>"
+ *
+ *   pocket-cube verify [--threads T]
+ *       solves every state with DBL solved (with 1, 2, 4, ... and T threads), replays each solution
+ *       with PocketCube's turns, and checks the distance histograms (quarter and half turns)
+ *       against the known ones; reports throughput and peak memory, and fails on any mismatch
+ *
+ *   pocket-cube export-tables <output>
+ *       writes the compressed distance table that fast-start WASM builds embed
+ *
+ * Any command may be preceded by "--trace <file>", which writes the events recorded while it
+ * runs to file, in Chrome's trace-event format (only builds with -DTRACING record events).
+ */
+
+/* ~ ~ ~ ~ Options ~ ~ ~ ~ */
+
+// Options: the "--name value" / "-n value" pairs following a command
+struct Options {
+    vector<std::pair<string, string>> values;
+    const char* dangling = nullptr; // an argument left without a value (the last one, if argc is odd)
+
+    Options(int argc, char** argv) {
+        for(int i = 0; i + 1 < argc; i += 2) values.emplace_back(argv[i], argv[i + 1]);
+        if(argc % 2 == 1) dangling = argv[argc - 1];
+    }
+
+    // check: returns whether every name is one of the allowed ones and has a value, or prints the
+    // first one that doesn't
+    bool check(std::initializer_list<const char*> allowed) const {
+        for(const auto& value : values) {
+            if(std::none_of(allowed.begin(), allowed.end(), [&](const char* name) { return value.first == name; })) {
+                fprintf(stderr, "unknown option: %s\n", value.first.c_str());
+                return false;
+            }
+        }
+
+        if(dangling != nullptr) {
+            fprintf(stderr, "missing value for %s\n", dangling);
+            return false;
+        }
+
+        return true;
+    }
+
+    // get: returns the value of the first of the given names that is present, or fallback
+    long long get(std::initializer_list<const char*> names, long long fallback) const {
+        for(const auto& value : values) {
+            for(const char* name : names) {
+                if(value.first == name) return atoll(value.second.c_str());
+            }
+        }
+        return fallback;
+    }
+};
+
+// appendMoves (helper): appends the moves in move-name notation, separated by spaces
+void appendMoves(const byte* moves, int length, string& out) {
+    for(int i = 0; i < length; i++) {
+        if(i > 0) out.push_back(' ');
+        out += moveNames[moves[i]];
+    }
+}
+
+/* ~ ~ ~ ~ Scramble ~ ~ ~ ~ */
+
+constexpr long long SCRAMBLE_CHUNK_SIZE = 1 << 16; // scrambles generated by a thread at once
+
+int scrambleCommand(const Options& options) {
+    if(!options.check({"-n", "--count", "-d", "--depth", "--seed", "-t", "--threads"})) return 1;
+
+    const long long count = options.get({"-n", "--count"}, 1);
+    const int depth = options.get({"-d", "--depth"}, -1);
+    const unsigned long long seed = options.get({"--seed"}, std::random_device{}());
+    const int numThreads = std::max(1LL, options.get({"-t", "--threads"}, std::thread::hardware_concurrency()));
+
+    if(depth < -1 || depth > MAX_FIXED_DEPTH) { // (-1: any depth)
+        fprintf(stderr, "depth must be between 0 and %d\n", MAX_FIXED_DEPTH);
+        return 1;
+    }
+
+    Tables::get();
+
+    // every thread has its own generator (seeded seed + i), and fills one chunk per round;
+    // the chunks are written in order after each round
+    vector<Scrambler> scramblers;
+    for(int i = 0; i < numThreads; i++) scramblers.emplace_back(seed + i);
+
+    vector<string> chunks(numThreads);
+    for(long long done = 0; done < count; ) {
+        vector<std::thread> threads;
+        for(int i = 0; i < numThreads; i++) {
+            const long long chunkSize = std::max(0LL, std::min(SCRAMBLE_CHUNK_SIZE, count - done - i * SCRAMBLE_CHUNK_SIZE));
+
+            threads.emplace_back([&, i, chunkSize]() {
+                byte scramble[MAX_FIXED_DEPTH];
+                chunks[i].clear();
+                for(long long k = 0; k < chunkSize; k++) {
+                    appendMoves(scramble, scramblers[i].next(scramble, depth), chunks[i]);
+                    chunks[i].push_back('\n');
+                }
+            });
+        }
+
+        for(int i = 0; i < numThreads; i++) {
+            threads[i].join();
+            fwrite(chunks[i].data(), 1, chunks[i].size(), stdout);
+        }
+
+        done += numThreads * SCRAMBLE_CHUNK_SIZE;
+    }
+
+    return 0;
+}
+
+/* ~ ~ ~ ~ Permutations ~ ~ ~ ~ */
+
+// compile (helper): parses the moves into a single permutation, or prints an error
+bool compile(const char* moves, Permutation& p) {
+    vector<byte> turns;
+    if(!parseMoves(moves, turns)) {
+        fprintf(stderr, "invalid moves: %s\n", moves);
+        return false;
+    }
+
+    p = Permutation::ofTurns(turns);
+    return true;
+}
+
+int orderCommand(const char* moves) {
+    Permutation p;
+    if(!compile(moves, p)) return 1;
+
+    printf("order %lld, cycles", p.order());
+    for(const int& length : p.cycleLengths()) printf(" %d", length);
+    printf("\n");
+
+    return 0;
+}
+
+int applyCommand(const char* moves, const Options& options, const char* state) {
+    if(!options.check({"-k", "--state"})) return 1;
+
+    Permutation p;
+    if(!compile(moves, p)) return 1;
+
+    PocketCube c;
+    if(state != nullptr && PocketCube::parse(state, c) != STATE_VALID) {
+        fprintf(stderr, "invalid state: %s\n", state);
+        return 1;
+    }
+
+    printf("%s\n", p.power(options.get({"-k"}, 1)).apply(c).toString().c_str());
+    return 0;
+}
+
+/* ~ ~ ~ ~ Binary Records ~ ~ ~ ~ */
+
+constexpr size_t SOLVE_CHUNK_SIZE = 1 << 12;   // states solved by a thread at once
+
+int encodeCommand(const char* output, const char* kind) {
+    const bool solutions = kind != nullptr && !strcmp(kind, "--solutions");
+    const int format = kind != nullptr && !strcmp(kind, "--stickers") ? RECORD_STICKERS : RECORD_RANK;
+
+    BlockWriter writer;
+    if(!writer.open(output)) {
+        perror(output);
+        return 1;
+    }
+    writer.write(solutions ? solutionFileHeader() : stateFileHeader(format));
+
+    string line, record;
+    vector<byte> path;
+    char buffer[1024];
+
+    for(long long lineNumber = 1; fgets(buffer, sizeof(buffer), stdin) != nullptr; lineNumber++) {
+        line = buffer;
+        while(!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+        record.clear();
+
+        bool valid;
+        if(solutions) {
+            path.clear();
+            valid = line.rfind("ERR", 0) == 0 || (parseMoves(line, path) && path.size() < UNSOLVED_RECORD);
+            appendSolutionRecord(path.data(), line.rfind("ERR", 0) == 0 ? -1 : path.size(), record);
+        } else {
+            PocketCube c;
+            int status = PocketCube::parse(line, c);
+            valid = (status == STATE_VALID || (format == RECORD_STICKERS && status != STATE_BAD_FORMAT)) &&
+                    appendStateRecord(c, format, record);
+        }
+
+        if(!valid) {
+            fprintf(stderr, "line %lld: invalid %s: %s\n", lineNumber, solutions ? "solution" : "state", line.c_str());
+            return 1;
+        }
+        writer.write(record);
+    }
+
+    return writer.close() ? 0 : 1;
+}
+
+int decodeCommand(const char* input) {
+    StateReader states;
+    SolutionReader solutions;
+    BlockWriter writer;
+    writer.open("-");
+
+    bool truncated;
+    if(states.open(input)) {
+        PocketCube c;
+        for(size_t i = 0; i < states.count; i++) writer.write(states.at(i, c) ? c.toString() + "\n" : "ERR invalid record\n");
+        truncated = states.truncated;
+    } else if(solutions.open(input)) {
+        vector<byte> path;
+        bool solved;
+        string line;
+
+        while(solutions.next(path, solved)) {
+            line.clear();
+            if(solved) appendMoves(path.data(), path.size(), line);
+            else line = "ERR unsolved";
+            line.push_back('\n');
+            writer.write(line);
+        }
+        truncated = solutions.truncated;
+    } else {
+        fprintf(stderr, "%s: not a binary state or solution file\n", input);
+        return 1;
+    }
+
+    if(!writer.close()) return 1;
+    if(truncated) {
+        fprintf(stderr, "%s: truncated (the file ends in the middle of a record)\n", input);
+        return 1;
+    }
+
+    return 0;
+}
+
+int solveBatchCommand(const char* input, const char* output, const Options& options) {
+    if(!options.check({"-t", "--threads"})) return 1;
+
+    const int numThreads = std::max(1LL, options.get({"-t", "--threads"}, std::thread::hardware_concurrency()));
+
+    StateReader states;
+    BlockWriter writer;
+    if(!states.open(input)) {
+        fprintf(stderr, "%s: not a binary state file\n", input);
+        return 1;
+    }
+    if(states.truncated) {
+        fprintf(stderr, "%s: truncated (the file ends in the middle of a record)\n", input);
+        return 1;
+    }
+    if(!writer.open(output)) {
+        perror(output);
+        return 1;
+    }
+
+    Tables::get();
+    writer.write(solutionFileHeader());
+
+    // (as in scrambleCommand) every thread solves one chunk per round, written in order
+    vector<string> chunks(numThreads);
+    vector<SolverContext> contexts(numThreads);
+    for(size_t done = 0; done < states.count; ) {
+        vector<std::thread> threads;
+        for(int i = 0; i < numThreads; i++) {
+            const size_t begin = std::min(states.count, done + i * SOLVE_CHUNK_SIZE);
+            const size_t end = std::min(states.count, begin + SOLVE_CHUNK_SIZE);
+
+            threads.emplace_back([&, i, begin, end]() {
+                chunks[i].clear();
+                PocketCube c;
+                for(size_t k = begin; k < end; k++) {
+                    if(!states.at(k, c)) { // (an invalid record has no solution)
+                        appendSolutionRecord(nullptr, -1, chunks[i]);
+                        continue;
+                    }
+
+                    const SolveResult& result = solveWithTables(contexts[i], c, SolveOptions{});
+                    const bool solved = result.status == SOLVE_OPTIMAL;
+                    appendSolutionRecord(result.path.data(), solved ? result.path.size() : -1, chunks[i]);
+                }
+            });
+        }
+
+        for(int i = 0; i < numThreads; i++) {
+            threads[i].join();
+            writer.write(chunks[i]);
+        }
+
+        done += numThreads * SOLVE_CHUNK_SIZE;
+    }
+
+    return writer.close() ? 0 : 1;
+}
+
+/* ~ ~ ~ ~ Masked Goals ~ ~ ~ ~ */
+
+int solveGoalCommand(const char* pattern, const Options& options) {
+    if(!options.check({"-t", "--threads"})) return 1;
+
+    const int numThreads = std::max(1LL, options.get({"-t", "--threads"}, std::thread::hardware_concurrency()));
+
+    Goal goal;
+    if(Goal::parse(pattern, goal) != STATE_VALID) {
+        fprintf(stderr, "invalid goal: %s\n", pattern);
+        return 1;
+    }
+
+    vector<string> states;
+    char buffer[1024];
+    while(fgets(buffer, sizeof(buffer), stdin) != nullptr) states.emplace_back(buffer);
+
+    // (solving any state builds the goal's table, once, before the threads start)
+    SolverContext context;
+    if(solveToGoal(context, PocketCube(), goal, SolveOptions{}).status == SOLVE_UNSOLVABLE) {
+        fprintf(stderr, "no state matches the goal: %s\n", pattern);
+        return 1;
+    }
+
+    // every thread answers an equal share of the states
+    vector<string> outputs(numThreads);
+    vector<std::thread> threads;
+
+    for(int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            SolverContext context;
+            for(size_t k = states.size() * i / numThreads; k < states.size() * (i + 1) / numThreads; k++) {
+                PocketCube c;
+                int status = PocketCube::parse(states[k], c);
+                if(status == STATE_VALID) {
+                    const SolveResult& result = solveToGoal(context, c, goal, SolveOptions{});
+                    if(result.status == SOLVE_OPTIMAL) appendMoves(result.path.data(), result.path.size(), outputs[i]);
+                    else outputs[i] += "ERR unsolved";
+                } else {
+                    outputs[i] += "ERR invalid state";
+                }
+                outputs[i].push_back('\n');
+            }
+        });
+    }
+
+    for(int i = 0; i < numThreads; i++) {
+        threads[i].join();
+        fwrite(outputs[i].data(), 1, outputs[i].size(), stdout);
+    }
+
+    return 0;
+}
+
+/* ~ ~ ~ ~ Verification ~ ~ ~ ~ */
+
+constexpr int VERIFY_CHUNK_SIZE = 1 << 12; // states taken by a thread at once
+
+// the number of states (with DBL solved) at each distance from solved
+const long long QTM_DISTRIBUTION[] = {1, 6, 27, 120, 534, 2256, 8969, 33058, 114149, 360508, 930588,
+                                      1350852, 782536, 90280, 276}; // quarter turns
+const long long HTM_DISTRIBUTION[] = {1, 9, 54, 321, 1847, 9992, 50136, 227536, 870072, 1887748,
+                                      623800, 2644};                // quarter and half turns
+
+// VerifyCounts: what a verification pass found
+struct VerifyCounts {
+    long long histogram[SOLVE_BUFFER_SIZE + 1] = {}; // [solution length]
+    long long failures = 0; // states whose solution doesn't solve them, or isn't optimal
+};
+
+// verifyPass (helper): solves every coordinate with the given number of threads, replaying each
+// solution on the decoded state; returns the counts of all threads together
+VerifyCounts verifyPass(int numThreads) {
+    const Tables& tables = Tables::get();
+    std::atomic<int> next(0);
+    vector<VerifyCounts> counts(numThreads);
+    vector<std::thread> threads;
+
+    for(int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            SolverContext context;
+            VerifyCounts& mine = counts[i];
+
+            for(int begin; (begin = next.fetch_add(VERIFY_CHUNK_SIZE)) < NUM_STATES; ) {
+                for(int index = begin; index < std::min(NUM_STATES, begin + VERIFY_CHUNK_SIZE); index++) {
+                    PocketCube c = PocketCube::fromCubies(Tables::decode(index));
+                    const SolveResult& result = solveWithTables(context, c, SolveOptions{});
+                    const int length = result.path.size();
+
+                    for(const byte& move : result.path) turn(c, move);
+
+                    if(result.status != SOLVE_OPTIMAL || c != PocketCube::solved ||
+                       length != tables.distance(index)) mine.failures++;
+                    else mine.histogram[length]++;
+                }
+            }
+        });
+    }
+
+    VerifyCounts total;
+    for(int i = 0; i < numThreads; i++) {
+        threads[i].join();
+        for(int d = 0; d <= SOLVE_BUFFER_SIZE; d++) total.histogram[d] += counts[i].histogram[d];
+        total.failures += counts[i].failures;
+    }
+
+    return total;
+}
+
+// halfTurnHistogram (helper): the number of coordinates at each distance from solved, counting
+// half turns as one move (by a breadth-first search over the move table)
+vector<long long> halfTurnHistogram() {
+    const Tables& tables = Tables::get();
+    vector<byte> depths(NUM_STATES, 0xFF);
+    vector<long long> histogram;
+
+    depths[0] = 0; // (the solved coordinate, as in TableLoader)
+    for(int depth = 0, found = 1; found > 0; depth++) {
+        histogram.push_back(found);
+        found = 0;
+
+        for(int index = 0; index < NUM_STATES; index++) {
+            if(depths[index] != depth) continue;
+
+            for(int m = 0; m < 6; m++) {
+                const int once = tables.move(index, m);
+                for(const int& neigh : {once, m < 3 ? tables.move(once, m) : once}) { // (U, R, F also turn twice)
+                    if(depths[neigh] != 0xFF) continue;
+                    depths[neigh] = depth + 1;
+                    found++;
+                }
+            }
+        }
+    }
+
+    return histogram;
+}
+
+// printHistogram (helper): prints the histogram next to the expected one; returns whether they match
+bool printHistogram(const char* name, const vector<long long>& histogram, const long long* expected, size_t expectedSize) {
+    bool matches = histogram.size() == expectedSize;
+    printf("%s distribution:", name);
+
+    for(size_t d = 0; d < std::max(histogram.size(), expectedSize); d++) {
+        const long long found = d < histogram.size() ? histogram[d] : 0;
+        const long long wanted = d < expectedSize ? expected[d] : 0;
+        matches &= found == wanted;
+
+        printf(" %lld", found);
+        if(found != wanted) printf(" (expected %lld)", wanted);
+    }
+
+    printf(matches ? " ok\n" : " MISMATCH\n");
+    return matches;
+}
+
+int verifyCommand(const Options& options) {
+    if(!options.check({"-t", "--threads"})) return 1;
+
+    const int maxThreads = std::max(1LL, options.get({"-t", "--threads"}, std::thread::hardware_concurrency()));
+    const auto startTime = std::chrono::steady_clock::now();
+    bool ok = true;
+
+    Tables::get();
+
+    vector<int> threadCounts;
+    for(int n = 1; n < maxThreads; n *= 2) threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    for(const int& numThreads : threadCounts) {
+        const auto passStart = std::chrono::steady_clock::now();
+        const VerifyCounts counts = verifyPass(numThreads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - passStart;
+
+        printf("%2d thread%s: %d states in %.2f s (%.0f states/s), %lld failures\n", numThreads,
+               numThreads == 1 ? " " : "s", NUM_STATES, elapsed.count(), NUM_STATES / elapsed.count(),
+               counts.failures);
+        fflush(stdout);
+
+        vector<long long> histogram(counts.histogram, counts.histogram + SOLVE_BUFFER_SIZE + 1);
+        while(!histogram.empty() && histogram.back() == 0) histogram.pop_back();
+
+        ok &= counts.failures == 0;
+        if(numThreads == threadCounts.back()) {
+            ok &= printHistogram("QTM", histogram, QTM_DISTRIBUTION, std::size(QTM_DISTRIBUTION));
+        }
+    }
+
+    ok &= printHistogram("HTM", halfTurnHistogram(), HTM_DISTRIBUTION, std::size(HTM_DISTRIBUTION));
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    printf("peak RSS %.1f MiB, total %.2f s: %s\n", usage.ru_maxrss / 1024.0, elapsed.count(), ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/* ~ ~ ~ ~ Main ~ ~ ~ ~ */
+
+int command(int argc, char** argv) {
+    if(argc >= 2 && !strcmp(argv[1], "scramble")) return scrambleCommand(Options(argc - 2, argv + 2));
+    if(argc == 3 && !strcmp(argv[1], "order")) return orderCommand(argv[2]);
+
+    if(argc >= 3 && !strcmp(argv[1], "apply")) {
+        const char* state = nullptr;
+        for(int i = 3; i + 1 < argc; i += 2) if(!strcmp(argv[i], "--state")) state = argv[i + 1];
+        return applyCommand(argv[2], Options(argc - 3, argv + 3), state);
+    }
+
+    if((argc == 3 || argc == 4) && !strcmp(argv[1], "encode")) return encodeCommand(argv[2], argc == 4 ? argv[3] : nullptr);
+    if(argc == 3 && !strcmp(argv[1], "decode")) return decodeCommand(argv[2]);
+    if(argc >= 3 && !strcmp(argv[1], "solve-goal")) return solveGoalCommand(argv[2], Options(argc - 3, argv + 3));
+    if(argc == 3 && !strcmp(argv[1], "export-tables")) {
+        if(writeCompressedTables(argv[2])) return 0;
+        perror(argv[2]);
+        return 1;
+    }
+    if(argc >= 4 && !strcmp(argv[1], "solve-batch")) return solveBatchCommand(argv[2], argv[3], Options(argc - 4, argv + 4));
+    if(argc >= 2 && !strcmp(argv[1], "verify")) return verifyCommand(Options(argc - 2, argv + 2));
+
+    fprintf(stderr, "usage: %s [--trace file] scramble [-n count] [-d depth] [--seed S] [--threads T]\n"
+                    "       %s order <moves>\n"
+                    "       %s apply <moves> [-k repetitions] [--state S]\n"
+                    "       %s encode <output> [--stickers | --solutions]\n"
+                    "       %s decode <input>\n"
+                    "       %s solve-batch <input> <output> [--threads T]\n"
+                    "       %s solve-goal <goal> [--threads T]\n"
+                    "       %s verify [--threads T]\n"
+                    "       %s export-tables <output>\n",
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3 || strcmp(argv[1], "--trace")) return command(argc, argv);
+
+    const char* tracePath = argv[2];
+    argv[2] = argv[0];
+    const int status = command(argc - 2, argv + 2);
+
+    FILE* trace = fopen(tracePath, "w");
+    if(trace == nullptr || fputs(traceJson().c_str(), trace) < 0 || fclose(trace) != 0) {
+        perror(tracePath);
+        return 1;
+    }
+
+    return status;
+}
@@ -72,6 +72,142 @@
                                            PocketCube::faceColor(BLUE, BLUE, BLUE, BLUE),
                                            PocketCube::faceColor(WHITE, WHITE, WHITE, WHITE)};
 
+    // sticker: returns the color ID at the given face ID and cell ID
+    byte PocketCube::sticker(byte face, byte cell) const {
+        return (state[face] >> 4 * cell) & 0b1111;
+    }
+
+    // setSticker: sets the color ID at the given face ID and cell ID
+    void PocketCube::setSticker(byte face, byte cell, byte color) {
+        state[face] = (short)((state[face] & ~(0b1111 << 4 * cell)) | (color << 4 * cell));
+    }
+
+    /* ~ ~ ~ ~ Cubie Representation / Validation ~ ~ ~ ~ */
+
+    // cornerLookup (helper):
+    // maps the colors read clockwise from a corner location, (c0 * 6 + c1) * 6 + c2, to
+    // (corner ID << 2 | twist), or to 0xFF if those colors don't form a real corner.
+    const byte* cornerLookup() {
+        static const std::array<byte, 6 * 6 * 6> lookup = []() { // (built once, thread-safely)
+            std::array<byte, 6 * 6 * 6> lookup;
+            lookup.fill(0xFF);
+
+            for(int corner = 0; corner < 8; corner++) {
+                byte colors[3];
+                for(int i = 0; i < 3; i++) {
+                    colors[i] = PocketCube::solved.sticker(cornerFacelets[corner][i][0], cornerFacelets[corner][i][1]);
+                }
+
+                // with twist t, the corner's U/D sticker (colors[0]) is read at index t
+                for(int twist = 0; twist < 3; twist++) {
+                    byte c0 = colors[(3 - twist) % 3], c1 = colors[(4 - twist) % 3], c2 = colors[(5 - twist) % 3];
+                    lookup[(c0 * 6 + c1) * 6 + c2] = (byte)(corner << 2 | twist);
+                }
+            }
+
+            return lookup;
+        }();
+
+        return lookup.data();
+    }
+
+    // toCubies:
+    // converts the sticker state to cubie form, verifying (in order) that each color appears exactly
+    // four times, that each corner location holds a real corner (with its colors in the right clockwise
+    // order), that no corner appears twice, and that the twists sum to a multiple of 3 (any permutation
+    // of the corners is reachable, so no permutation-parity check is needed). Returns a STATE_* code.
+    int PocketCube::toCubies(CubieCube& cubies) const {
+        int colorCounts[16] = {0};
+        for(const short& face : state) {
+            for(int cell = 0; cell < 4; cell++) colorCounts[(face >> 4 * cell) & 0b1111]++;
+        }
+
+        for(int color = 0; color < 16; color++) {
+            if(colorCounts[color] != (color < 6 ? 4 : 0)) return STATE_BAD_COLOR_COUNT;
+        }
+
+        const byte* lookup = cornerLookup();
+        int foundCorners = 0; // bitmask of the corners that have been found
+        int twistSum = 0;
+
+        for(int location = 0; location < 8; location++) {
+            const byte (*facelets)[2] = cornerFacelets[location];
+            byte entry = lookup[(sticker(facelets[0][0], facelets[0][1]) * 6 +
+                                 sticker(facelets[1][0], facelets[1][1])) * 6 +
+                                 sticker(facelets[2][0], facelets[2][1])];
+
+            if(entry == 0xFF) return STATE_BAD_CORNER;
+            if(foundCorners & 1 << (entry >> 2)) return STATE_DUPLICATE_CORNER;
+
+            foundCorners |= 1 << (entry >> 2);
+            cubies.corners[location] = entry >> 2;
+            cubies.twists[location] = entry & 0b11;
+            twistSum += entry & 0b11;
+        }
+
+        return twistSum % 3 == 0 ? STATE_VALID : STATE_TWISTED;
+    }
+
+    // fromCubies: builds the sticker state of the given cubie form
+    PocketCube PocketCube::fromCubies(const CubieCube& cubies) {
+        PocketCube c;
+
+        for(int location = 0; location < 8; location++) {
+            const byte corner = cubies.corners[location];
+            for(int i = 0; i < 3; i++) {
+                const byte* from = cornerFacelets[corner][i];
+                const byte* to = cornerFacelets[location][(i + cubies.twists[location]) % 3];
+                c.setSticker(to[0], to[1], solved.sticker(from[0], from[1]));
+            }
+        }
+
+        return c;
+    }
+
+    // parse:
+    // parses 24 color characters (B, G, O, R, W, Y; whitespace is ignored), given face-by-face
+    // in the order U, L, F, R, B, D, and validates the result (see toCubies). out is assigned
+    // unless the format is bad (so invalid stickers can still be inspected). Returns a STATE_* code.
+    int PocketCube::parse(const string& text, PocketCube& out) {
+        PocketCube c;
+        int numStickers = 0;
+
+        for(const char& ch : text) {
+            if(isspace((unsigned char) ch)) continue;
+
+            const char* match = std::find(colorIdToChar, colorIdToChar + 6, toupper((unsigned char) ch));
+            if(match == colorIdToChar + 6 || numStickers == 24) return STATE_BAD_FORMAT;
+
+            c.setSticker(numStickers / 4, logicalCells[numStickers % 4], (byte)(match - colorIdToChar));
+            numStickers++;
+        }
+
+        if(numStickers != 24) return STATE_BAD_FORMAT;
+
+        CubieCube cubies;
+        out = c;
+
+        return c.toCubies(cubies);
+    }
+
+    // toString: returns the state as 24 color characters (see parse; a sticker that isn't a color
+    // ID prints as '?')
+    string PocketCube::toString() const {
+        string text(24, '?');
+        for(int i = 0; i < 24; i++) {
+            const byte color = sticker(i / 4, logicalCells[i % 4]);
+            if(color < 6) text[i] = colorIdToChar[color];
+        }
+
+        return text;
+    }
+
+    // isSolvable: checks that the state is valid (see toCubies)
+    bool PocketCube::isSolvable() const {
+        CubieCube cubies;
+        return toCubies(cubies) == STATE_VALID;
+    }
+
     bool PocketCube::operator==(const PocketCube& other) const {
         return state == other.state;
     }
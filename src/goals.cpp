@@ -0,0 +1,211 @@
+#include "solver.h"
+
+#include <memory>
+#include <mutex>
+
+/* ~ ~ ~ ~ Goals ~ ~ ~ ~ */
+
+// parse: reads the pattern (whitespace is ignored), and finds which corners (with which twists)
+// fit each location: those whose stickers match every sticker of the pattern that matters there
+int Goal::parse(const string& text, Goal& out) {
+    Goal goal;
+    byte pattern[6][4]; // [face][cell]: color ID, or 0xFF if it doesn't matter
+
+    for(const char& ch : text) {
+        if(isspace((unsigned char) ch)) continue;
+        if(goal.pattern.size() == 24) return STATE_BAD_FORMAT;
+
+        const int i = goal.pattern.size();
+        const char upper = toupper((unsigned char) ch);
+        const char* match = std::find(colorIdToChar, colorIdToChar + 6, upper);
+
+        if(upper == '?' || upper == '.') pattern[i / 4][logicalCells[i % 4]] = 0xFF;
+        else if(match != colorIdToChar + 6) pattern[i / 4][logicalCells[i % 4]] = match - colorIdToChar;
+        else return STATE_BAD_FORMAT;
+
+        goal.pattern.push_back(upper == '.' ? '?' : upper);
+    }
+
+    if(goal.pattern.size() != 24) return STATE_BAD_FORMAT;
+
+    for(int location = 0; location < 8; location++) {
+        goal.allowed[location] = 0;
+
+        for(int corner = 0; corner < 8; corner++) {
+            for(int twist = 0; twist < 3; twist++) {
+                bool fits = true;
+                for(int i = 0; i < 3; i++) { // (the corner's ith sticker is read at index i + twist)
+                    const byte* at = cornerFacelets[location][(i + twist) % 3];
+                    const byte* from = cornerFacelets[corner][i];
+                    const byte color = pattern[at[0]][at[1]];
+                    fits &= color == 0xFF || color == PocketCube::solved.sticker(from[0], from[1]);
+                }
+
+                if(fits) goal.allowed[location] |= 1 << (corner * 3 + twist);
+            }
+        }
+    }
+
+    out = goal;
+    return STATE_VALID;
+}
+
+bool Goal::matches(const CubieCube& c) const {
+    for(int location = 0; location < 8; location++) {
+        if(!(allowed[location] >> (c.corners[location] * 3 + c.twists[location]) & 1)) return false;
+    }
+
+    return true;
+}
+
+/* ~ ~ ~ ~ Goal Tables ~ ~ ~ ~ */
+
+typedef std::shared_ptr<const vector<byte>> GoalTable;
+
+// buildGoalTable (helper):
+// returns the distance (in quarter turns, or 0xFF if unreachable) of every coordinate to the
+// nearest state that matches the goal in any orientation. Those states are found by checking
+// each coordinate against the goal rotated each of the 24 ways, and are the sources of a
+// breadth-first search. Turning the cube (by any turn) changes its canonical coordinate by one
+// FIXED_TURN, and the set of sources doesn't depend on orientation, so the table is a lower bound
+// on the distance to the goal itself (and changes by at most 1 per turn).
+GoalTable buildGoalTable(const Goal& goal) {
+    TRACE_SCOPE("buildGoalTable");
+    const Tables& tables = Tables::get();
+
+    // rotatedAllowed[r][l]: the corners (and twists) that may be at l for the state to match the
+    // goal after rotations[r]; only the rotations that allow DBL to stay home are kept
+    vector<std::array<unsigned int, 8>> rotatedAllowed;
+    for(const CubieMap& rotation : tables.rotations) {
+        std::array<unsigned int, 8> allowed;
+        for(int l = 0; l < 8; l++) {
+            unsigned int bits = 0;
+            for(int corner = 0; corner < 8; corner++) {
+                for(int twist = 0; twist < 3; twist++) {
+                    if(goal.allowed[l] >> (corner * 3 + (twist + rotation.delta[l]) % 3) & 1) bits |= 1 << (corner * 3 + twist);
+                }
+            }
+            allowed[rotation.from[l]] = bits;
+        }
+
+        if(allowed[DBL] & 1 << DBL * 3) rotatedAllowed.push_back(allowed);
+    }
+
+    // twistsOf[twist]: the twist of every location, for each twist coordinate
+    vector<std::array<byte, 8>> twistsOf(NUM_TWISTS);
+    for(int twist = 0; twist < NUM_TWISTS; twist++) {
+        CubieCube c = Tables::decode(twist);
+        std::copy(c.twists, c.twists + 8, twistsOf[twist].begin());
+    }
+
+    auto depths = std::make_shared<vector<byte>>(NUM_STATES, 0xFF);
+    vector<byte>& d = *depths;
+
+    for(int perm = 0; perm < NUM_PERMS; perm++) {
+        const CubieCube c = Tables::decode(perm * NUM_TWISTS);
+
+        for(const auto& allowed : rotatedAllowed) {
+            byte twistMasks[8]; // the twists that may go with this permutation, at each location
+            bool possible = true;
+            for(int l = 0; l < 8; l++) {
+                twistMasks[l] = allowed[l] >> c.corners[l] * 3 & 0b111;
+                possible &= twistMasks[l] != 0;
+            }
+            if(!possible) continue;
+
+            for(int twist = 0; twist < NUM_TWISTS; twist++) {
+                bool fits = true;
+                for(int l = 0; l < 8 && fits; l++) fits = twistMasks[l] >> twistsOf[twist][l] & 1;
+                if(fits) d[perm * NUM_TWISTS + twist] = 0;
+            }
+        }
+    }
+
+    for(int depth = 0, found = 1; found > 0; depth++) {
+        found = 0;
+        for(int index = 0; index < NUM_STATES; index++) {
+            if(d[index] != depth) continue;
+
+            for(int m = 0; m < 6; m++) {
+                int neigh = tables.move(index, m);
+                if(d[neigh] != 0xFF) continue;
+                d[neigh] = depth + 1;
+                found++;
+            }
+        }
+    }
+
+    return depths;
+}
+
+// goalTable (helper): returns the goal's table, from the cache if it was built recently
+GoalTable goalTable(const Goal& goal) {
+    static std::mutex mutex;
+    static vector<std::pair<string, GoalTable>> cache; // (most recently used last)
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < cache.size(); i++) {
+            if(cache[i].first != goal.pattern) continue;
+
+            std::rotate(cache.begin() + i, cache.begin() + i + 1, cache.end());
+            return cache.back().second;
+        }
+    }
+
+    GoalTable table = buildGoalTable(goal); // (two threads may build the same table; both are correct)
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(cache.size() == MAX_CACHED_GOALS) cache.erase(cache.begin());
+    cache.emplace_back(goal.pattern, table);
+
+    return table;
+}
+
+/* ~ ~ ~ ~ Goal Solving ~ ~ ~ ~ */
+
+// GoalSearch: iterative-deepening A* over all 12 turns, towards any state that matches the
+// goal, with the goal table as the heuristic (see TableSearch)
+struct GoalSearch : IDASearch {
+    const Goal& goal;
+    const vector<byte>& distances;
+
+    GoalSearch(const Goal& goal, const vector<byte>& distances, const SolveOptions& options):
+        IDASearch(options), goal(goal), distances(distances) { }
+
+    // search: depth-first search for a solution of exactly bound moves (depth = number of moves so far)
+    bool search(const CubieCube& c, int depth, int bound) {
+        if(goal.matches(c)) return depth == bound;
+        if(depth + distances[tables.canonicalIndex(c)] > bound || aborted || !expand()) return false;
+
+        for(int tid = 0; tid < 12; tid++) {
+            if(redundantTurn(path, depth, tid)) continue;
+
+            path[depth] = tid;
+            if(search(tables.turns[tid].apply(c), depth + 1, bound)) return true;
+        }
+
+        return false;
+    }
+};
+
+const SolveResult& solveToGoal(SolverContext& context, const PocketCube& startNode, const Goal& goal,
+                               const SolveOptions& options) {
+    TRACE_SCOPE("solveToGoal");
+    SolveResult& result = context.result;
+    result.path.clear();
+    result.status = SOLVE_UNSOLVABLE;
+
+    CubieCube start;
+    if(startNode.toCubies(start) != STATE_VALID) return result;
+
+    GoalTable table = goalTable(goal);
+    GoalSearch search(goal, *table, options);
+
+    const int h = (*table)[search.tables.canonicalIndex(start)];
+    if(h == 0xFF) return result; // (no state matches the goal)
+
+    search.deepen(h, [&](int bound) { return search.search(start, 0, bound); }, result);
+
+    return result;
+}
@@ -179,7 +179,7 @@
         for(const Point& corner : corners) {
             currentDist = corner.dist(planeIntersection);
 
-            if(abs(currentDist - minDist) < 2.0) { // equidistant to two closest points (epsilon = 2.0): color black.
+            if(fabs(currentDist - minDist) < 2.0) { // equidistant to two closest points (epsilon = 2.0): color black.
                 planeIntersection.color = BLACK_RGBA;
             } else if(currentDist < minDist) {
                 planeIntersection.color = corner.color;
@@ -231,6 +231,116 @@
     }
 // }
 
+// FaceKernel / RayKernel: a structure-of-arrays version of POV::rectRaycast that casts LANES
+// adjacent pixels at once. Every lane performs the same double-precision operations, in the
+// same order, as Plane::lineIntersection and Rect::lineIntersection, so the output is
+// identical to the scalar path (build with -DSCALAR_RENDERER to compare).
+// {
+    // sqrtLanes (helper): lane-wise square root (the loop is vectorized by the compiler)
+    static inline doubleLanes sqrtLanes(const doubleLanes v) {
+        doubleLanes r;
+        for(int k = 0; k < LANES; k++) r[k] = sqrt(v[k]);
+        return r;
+    }
+
+    // constructor (rect)
+    FaceKernel::FaceKernel(const Rect& r) {
+        A = r.plane.norm.dx;
+        B = r.plane.norm.dy;
+        C = r.plane.norm.dz;
+        D = A * r.plane.p1.x + B * r.plane.p1.y + C * r.plane.p1.z;
+
+        for(int k = 0; k < 4; k++) {
+            const Point& corner = r.corners[k];
+            const Point& next = r.corners[(k + 1) % 4];
+
+            cx[k] = corner.x;
+            cy[k] = corner.y;
+            cz[k] = corner.z;
+            ex[k] = corner.x - next.x;
+            ey[k] = corner.y - next.y;
+            ez[k] = corner.z - next.z;
+            colors[k] = corner.color;
+        }
+    }
+
+    // constructor (pov, faces)
+    RayKernel::RayKernel(const POV& pov, const vector<Rect>& faces) : faces(faces.begin(), faces.end()),
+              viewpoint(pov.viewpoint), halfWidth(pov.width / 2), halfHeight(pov.height / 2), setback(pov.setback) {
+        TRACE_SCOPE("RayKernel::RayKernel");
+    }
+
+    // renderRow: raycasts the screen row at height y, writing the color of the nearest face
+    // (or white) into row[0..width)
+    void RayKernel::renderRow(int *row, const int width, const double y) const {
+        // screen point (x0, y0, z0) and direction (dx, dy, dz) of each lane's ray
+        const double y0 = y - halfHeight;
+        const double z0 = -setback;
+        const double dy = y0 - viewpoint.y;
+        const double dz = z0 - viewpoint.z;
+        const maskLanes black = maskLanes{} + BLACK_RGBA;
+
+        for(int j = 0; j < width; j += LANES) {
+            doubleLanes x0;
+            for(int k = 0; k < LANES; k++) x0[k] = j + k;
+            x0 = x0 - halfWidth;
+            const doubleLanes dx = x0 - viewpoint.x;
+
+            doubleLanes bestZ = doubleLanes{} + 1e10; // z-value of point closest to the viewpoint
+            maskLanes color = maskLanes{} + WHITE_RGBA;
+
+            for(const FaceKernel& f : faces) {
+                // line-plane intersection
+                const doubleLanes denom = f.A * dx + f.B * dy + f.C * dz;
+                const doubleLanes t = (f.D - (f.A * x0 + f.B * y0 + f.C * z0)) / denom;
+                const doubleLanes px = x0 + dx * t;
+                const doubleLanes py = y0 + dy * t;
+                const doubleLanes pz = z0 + dz * t;
+
+                // dot product of point and all sides
+                doubleLanes dots[4];
+                for(int k = 0; k < 4; k++) {
+                    dots[k] = f.ex[k] * (f.cx[k] - px) + f.ey[k] * (f.cy[k] - py) + f.ez[k] * (f.cz[k] - pz);
+                }
+
+                const maskLanes outside = (dots[0] < 0) | (dots[1] < 0) | (dots[2] < 0) | (dots[3] < 0);
+                const maskLanes hit = (denom != 0) & ~outside & (pz < bestZ);
+                long long anyHit = 0;
+                for(int k = 0; k < LANES; k++) anyHit |= hit[k];
+                if(!anyHit) continue;
+
+                // color of the nearest corner (or black if equidistant between two corners)
+                doubleLanes minDist = doubleLanes{} + 1e10;
+                maskLanes faceColor = black;
+                for(int k = 0; k < 4; k++) {
+                    const doubleLanes ox = f.cx[k] - px;
+                    const doubleLanes oy = f.cy[k] - py;
+                    const doubleLanes oz = f.cz[k] - pz;
+                    const doubleLanes dist = sqrtLanes(ox * ox + oy * oy + oz * oz);
+                    const doubleLanes diff = dist - minDist;
+
+                    const maskLanes equidistant = (diff < 2.0) & (diff > -2.0);
+                    const maskLanes closer = ~equidistant & (dist < minDist);
+                    faceColor = equidistant ? black : faceColor;
+                    faceColor = closer ? maskLanes{} + f.colors[k] : faceColor;
+                    minDist = closer ? dist : minDist;
+                }
+
+                // color cube's edges black
+                const doubleLanes minDot01 = dots[0] < dots[1] ? dots[0] : dots[1];
+                const doubleLanes minDot23 = dots[2] < dots[3] ? dots[2] : dots[3];
+                const doubleLanes minDot = minDot01 < minDot23 ? minDot01 : minDot23;
+                faceColor = minDot < 500.0 ? black : faceColor;
+
+                bestZ = hit ? pz : bestZ;
+                color = hit ? faceColor : color;
+            }
+
+            for(int k = 0; k < LANES && j + k < width; k++) row[j + k] = (int) color[k];
+        }
+    }
+// }
+
 // Cube: represents a 3-d object with 8 corners. Cubie-color is also held and
 // used in rendering.
 // {
@@ -262,6 +372,7 @@
 
     // rotate: returns a Cube rotated by the given degrees
     Cube Cube::rotate(const double xRad, const double yRad) const {
+        TRACE_SCOPE("Cube::rotate");
         vector<Point> rotatedCorners = corners;
         for(Point& corner : rotatedCorners) {
             double x = corner.x;
@@ -284,12 +395,8 @@
 
     // updateCubieColors: sets Cube::cubieColors to the appropriate RGBA values according to the cubeState
     void Cube::updateCubieColors() {
-        int i = 0;
-        for(const short& face : cubeState.state) {
-            for(const byte& colorId : PocketCube::extractFaceColors(face)) {
-                cubieColors[i++] = colorIdToRGBA(colorId);
-            }
-        }
+        TRACE_SCOPE("Cube::updateCubieColors");
+        for(int i = 0; i < 24; i++) cubieColors[i] = colorIdToRGBA(cubeState.sticker(i / 4, logicalCells[i % 4]));
     }
 
     // getFaces: returns a vector of Rect objects with their corner colors corresponding to their
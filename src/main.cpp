@@ -9,17 +9,55 @@ double xRotRad = 0, yRotRad = 0;    // rotation of cube (in radians)
 POV pov(WIDTH, HEIGHT, 300, 3000);  // point-of-view for rendering
 Cube cube(-100, -100, -100, 200);   // geometric cube to be rendered
 PocketCube cubeState;               // state of the cube during program execution
+SolverContext solverContext;        // scratch memory reused by every solveCube() call
+
+byte cubieColorBuffer[24];                  // Up(4) Left(4) Front(4) Right(4) Back(4) Down(4)
+byte solveBuffer[SOLVE_BUFFER_SIZE];        // contains solution moves that can be transfered to js
+short stateBuffer[6];                       // copy of cubeState.state that can be transfered to/from js
+byte scrambleBuffer[MAX_FIXED_DEPTH];       // contains scramble moves that can be transfered to js
+byte stickerChanges[24];                    // indices (into cubieColorBuffer) of the stickers that changed
+byte moveHints[12];                         // [turnID]: distance of cubeState after that turn
+
+MemoryLayout memoryLayout = {buffer, sizeof(buffer),
+                             cubieColorBuffer, sizeof(cubieColorBuffer),
+                             solveBuffer, sizeof(solveBuffer),
+                             0, 0, 0,
+                             stateBuffer, sizeof(stateBuffer),
+                             scrambleBuffer, sizeof(scrambleBuffer),
+                             stickerChanges, sizeof(stickerChanges),
+                             moveHints, sizeof(moveHints)};
+
+MemoryLayout *getMemoryLayout() {
+    return &memoryLayout;
+}
 
 int *getImageDataBuffer() {
     return buffer;
 }
 
-// draw: renders the cube and writes its color data in the buffer.
+// draw: renders the cube and writes its color data in the buffer (nothing is rendered if
+// neither the rotation nor the cube's state changed since the last frame).
 void draw() {
+    TRACE_SCOPE("draw");
+    static double drawnXRotRad = NAN, drawnYRotRad = NAN;
+    static int drawnStateGeneration = -1;
+
+    if(xRotRad == drawnXRotRad && yRotRad == drawnYRotRad &&
+       memoryLayout.stateGeneration == drawnStateGeneration) return;
+
+    drawnXRotRad = xRotRad;
+    drawnYRotRad = yRotRad;
+    drawnStateGeneration = memoryLayout.stateGeneration;
+    memoryLayout.frameGeneration++;
+
     Cube c = cube.rotate(xRotRad, yRotRad);
 
     Cube::updateCubieColors();
     vector<Rect> faces = c.getFaces();
+
+    TRACE_SCOPE("draw: raycast");
+
+#ifdef SCALAR_RENDERER // reference path: one rectRaycast per pixel per face
     Point collision;
 
     for(int i = 0; i < HEIGHT; i++) {
@@ -39,6 +77,10 @@ void draw() {
             buffer[i * WIDTH + j] = color;
         }
     }
+#else
+    RayKernel kernel(pov, faces);
+    for(int i = 0; i < HEIGHT; i++) kernel.renderRow(buffer + i * WIDTH, WIDTH, HEIGHT - i - 1);
+#endif
 }
 
 void setRotation(double x, double y) {
@@ -49,10 +91,15 @@ void setRotation(double x, double y) {
 // init: called once upon page-start
 void init() {
     cubeState = PocketCube::solved; // copy again here in case solved was initialized after cubeState
+    std::fill(cubieColorBuffer, cubieColorBuffer + 24, 0xFF); // (so the first getStickerChanges reports every sticker)
+    memoryLayout.stateGeneration++;
 }
 
 // executeTurn: executes the given turn ID
 void executeTurn(int turnId) {
+    TRACE_SCOPE("executeTurn");
+    memoryLayout.stateGeneration++;
+
     switch(turnId) {
         case 0:  cubeState.turnU();  return;
         case 1:  cubeState.turnL();  return;
@@ -69,26 +116,99 @@ void executeTurn(int turnId) {
     }
 }
 
-vector<byte> cubieColorBuffer;
+// saveState: copies cubeState into stateBuffer
+void saveState() {
+    std::copy(cubeState.state.begin(), cubeState.state.end(), stateBuffer);
+}
+
+// loadState: replaces cubeState with the contents of stateBuffer (used by the solver worker),
+// unless they don't form a valid state. Returns a STATE_* code.
+int loadState() {
+    TRACE_SCOPE("loadState");
+    PocketCube loaded;
+    std::copy(stateBuffer, stateBuffer + 6, loaded.state.begin());
+
+    CubieCube cubies;
+    int status = loaded.toCubies(cubies);
+    if(status != STATE_VALID) return status;
+
+    cubeState = loaded;
+    memoryLayout.stateGeneration++;
+
+    return STATE_VALID;
+}
 
 byte *getCubieColors() {
-    int i = 0;
-    for(const short& face : cubeState.state) {
-        for(const byte& colorId : PocketCube::extractFaceColors(face)) {
-            cubieColorBuffer[i++] = colorId;
-        }
-    }
+    for(int i = 0; i < 24; i++) cubieColorBuffer[i] = cubeState.sticker(i / 4, logicalCells[i % 4]);
 
-    return cubieColorBuffer.data();
+    return cubieColorBuffer;
 }
 
-vector<byte> solveBuffer; // contains solution moves that can be transfered to js
+// getStickerChanges: updates cubieColorBuffer, writing the index of every sticker whose color
+// changed since the last update (by this or getCubieColors) into stickerChanges, and returns the
+// number of changes
+int getStickerChanges() {
+    TRACE_SCOPE("getStickerChanges");
+    int numChanges = 0;
+
+    for(int i = 0; i < 24; i++) {
+        const byte color = cubeState.sticker(i / 4, logicalCells[i % 4]);
+        if(color == cubieColorBuffer[i]) continue;
 
+        cubieColorBuffer[i] = color;
+        stickerChanges[numChanges++] = i;
+    }
+
+    return numChanges;
+}
+
+// solveCube: solves cubeState (with the tables, finishing them first if prepareTables hasn't),
+// writes the moves into solveBuffer, and returns the number of moves
 int solveCube() {
-    solveBuffer = solve(cubeState);
-    return solveBuffer.size();
+    TRACE_SCOPE("solveCube");
+    const vector<byte>& solution = solveWithTables(solverContext, cubeState, SolveOptions{}).path;
+    int numMoves = std::min((int) solution.size(), SOLVE_BUFFER_SIZE);
+
+    std::copy(solution.begin(), solution.begin() + numMoves, solveBuffer);
+    memoryLayout.solveGeneration++;
+
+    return numMoves;
 }
 
 byte *getSolveBuffer() {
-    return solveBuffer.data();
+    return solveBuffer;
+}
+
+// solveMany: solves n states at once (see solveStates), so that js can analyze a list of states
+// with one call; the buffers are allocated by js (with _malloc). Leaves cubeState alone, and
+// returns the number of states solved (fewer than n if out filled up).
+int solveMany(const short* states, int n, byte* out, int capacity, int* offsets) {
+    TRACE_SCOPE("solveMany");
+    return solveStates(solverContext, states, n, out, capacity, offsets);
+}
+
+// getMoveHints: writes the distance (in quarter turns) of the state each turn would lead to into
+// moveHints, and returns the distance of cubeState; uses the tables (see solveCube)
+int getMoveHints() {
+    TRACE_SCOPE("getMoveHints");
+    int distances[12] = {};
+    const int distance = moveDistances(solverContext, cubeState, distances);
+
+    std::copy(distances, distances + 12, moveHints);
+    return distance;
+}
+
+// prepareTables: builds part of the solver tables (for about budgetMs), so that js can spread
+// the work over several tasks; returns 1 once they are ready
+int prepareTables(double budgetMs) {
+    return Tables::prepare(budgetMs);
+}
+
+Scrambler scrambler(std::random_device{}());
+
+// randomScramble: writes the optimal scramble of a uniformly random state (exactly depth turns
+// from solved, unless depth is -1) into scrambleBuffer, and returns the number of moves
+int randomScramble(int depth) {
+    TRACE_SCOPE("randomScramble");
+    return scrambler.next(scrambleBuffer, depth);
 }
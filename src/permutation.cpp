@@ -0,0 +1,146 @@
+#include "solver.h"
+
+#include <numeric>
+
+/* ~ ~ ~ ~ Permutations ~ ~ ~ ~ */
+
+// constructor (identity)
+Permutation::Permutation() {
+    for(int i = 0; i < 24; i++) from[i] = i;
+}
+
+// ofTurn:
+// returns the permutation performed by the given turn. It is found (once per turn) by running
+// the turn method on labeled stickers; each nibble only holds 16 labels, so the source of every
+// sticker is found in two passes: once labeled i % 8, and once labeled i / 8.
+Permutation Permutation::ofTurn(int turnId) {
+    static const std::array<Permutation, 12> turns = []() {
+        std::array<Permutation, 12> turns;
+
+        for(int tid = 0; tid < 12; tid++) {
+            PocketCube low, high;
+            for(int i = 0; i < 24; i++) {
+                low.setSticker(i / 4, i % 4, i % 8);
+                high.setSticker(i / 4, i % 4, i / 8);
+            }
+
+            turn(low, tid);
+            turn(high, tid);
+
+            for(int i = 0; i < 24; i++) {
+                turns[tid].from[i] = high.sticker(i / 4, i % 4) * 8 + low.sticker(i / 4, i % 4);
+            }
+        }
+
+        return turns;
+    }();
+
+    return turns[turnId];
+}
+
+// ofTurns: compiles the sequence of turnIDs into a single permutation
+Permutation Permutation::ofTurns(const vector<byte>& turns) {
+    Permutation p;
+    for(const byte& tid : turns) p = p.then(ofTurn(tid));
+
+    return p;
+}
+
+// apply: returns c with its stickers rearranged
+PocketCube Permutation::apply(const PocketCube& c) const {
+    PocketCube result;
+    for(int i = 0; i < 24; i++) result.setSticker(i / 4, i % 4, c.sticker(from[i] / 4, from[i] % 4));
+
+    return result;
+}
+
+// then: returns the permutation that performs *this, then next
+Permutation Permutation::then(const Permutation& next) const {
+    Permutation p;
+    for(int i = 0; i < 24; i++) p.from[i] = from[next.from[i]];
+
+    return p;
+}
+
+Permutation Permutation::inverse() const {
+    Permutation p;
+    for(int i = 0; i < 24; i++) p.from[from[i]] = i;
+
+    return p;
+}
+
+// power: returns *this repeated k times (O(log k) compositions)
+Permutation Permutation::power(long long k) const {
+    Permutation result, base = k < 0 ? inverse() : *this;
+
+    for(unsigned long long e = k < 0 ? -(unsigned long long) k : k; e > 0; e >>= 1) {
+        if(e & 1) result = result.then(base);
+        base = base.then(base);
+    }
+
+    return result;
+}
+
+// cycleLengths: returns the lengths of the non-trivial cycles, longest first
+vector<int> Permutation::cycleLengths() const {
+    vector<int> lengths;
+    bool seen[24] = {false};
+
+    for(int i = 0; i < 24; i++) {
+        int length = 0;
+        for(int j = i; !seen[j]; j = from[j]) {
+            seen[j] = true;
+            length++;
+        }
+        if(length > 1) lengths.push_back(length);
+    }
+
+    std::sort(lengths.rbegin(), lengths.rend());
+    return lengths;
+}
+
+// order: the least common multiple of the cycle lengths
+long long Permutation::order() const {
+    long long order = 1;
+    for(const int& length : cycleLengths()) order = std::lcm(order, (long long) length);
+
+    return order;
+}
+
+bool Permutation::operator==(const Permutation& other) const {
+    return std::equal(from, from + 24, other.from);
+}
+
+bool Permutation::operator!=(const Permutation& other) const {
+    return !(*this == other);
+}
+
+/* ~ ~ ~ ~ Move Notation ~ ~ ~ ~ */
+
+// parseMoves: appends the turnIDs of the move names in text (U, U', U2, ...) to turns
+bool parseMoves(const string& text, vector<byte>& turns) {
+    const string faces = "ULFRBD";
+
+    for(size_t i = 0; i < text.size(); ) {
+        if(isspace((unsigned char) text[i]) || text[i] == ',') {
+            i++;
+            continue;
+        }
+
+        size_t face = faces.find(toupper((unsigned char) text[i++]));
+        if(face == string::npos) return false;
+
+        if(i < text.size() && text[i] == '\'') {
+            turns.push_back(face + 6);
+            i++;
+        } else if(i < text.size() && text[i] == '2') {
+            turns.push_back(face);
+            turns.push_back(face);
+            i++;
+        } else {
+            turns.push_back(face);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,178 @@
+#include "solver.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr size_t WRITE_BLOCK_SIZE = 1 << 20; // bytes collected by a BlockWriter before each write
+
+/* ~ ~ ~ ~ Record Encoding ~ ~ ~ ~ */
+
+// appendInt (helper): appends value as a 4-byte little-endian integer
+void appendInt(unsigned int value, string& out) {
+    for(int i = 0; i < 4; i++) out.push_back((char)(value >> 8 * i));
+}
+
+// readInt (helper): reads a 4-byte little-endian integer
+unsigned int readInt(const byte* data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (unsigned int) data[3] << 24;
+}
+
+string stateFileHeader(int format) {
+    string header = "PCS1";
+    appendInt(format, header);
+    return header;
+}
+
+string solutionFileHeader() {
+    return "PCM1";
+}
+
+// appendStateRecord: appends c in the given format; ranking requires a valid state
+bool appendStateRecord(const PocketCube& c, int format, string& out) {
+    if(format == RECORD_STICKERS) {
+        for(const short& face : c.state) {
+            out.push_back((char) face);
+            out.push_back((char)(face >> 8));
+        }
+        return true;
+    }
+
+    CubieCube cubies;
+    if(c.toCubies(cubies) != STATE_VALID) return false;
+
+    appendInt(Tables::get().rank(cubies), out);
+    return true;
+}
+
+void appendSolutionRecord(const byte* path, int length, string& out) {
+    if(length < 0) {
+        out.push_back((char) UNSOLVED_RECORD);
+        return;
+    }
+
+    out.push_back((char) length);
+    for(int i = 0; i < length; i += 2) {
+        out.push_back((char)(path[i] | (i + 1 < length ? path[i + 1] << 4 : 0)));
+    }
+}
+
+/* ~ ~ ~ ~ Reading ~ ~ ~ ~ */
+
+// open: maps the whole file (read-only); the mapping outlives the file descriptor
+bool MappedFile::open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0) return false;
+
+    struct stat info;
+    if(fstat(fd, &info) < 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) return false;
+
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    data = (const byte*) mapping;
+    size = info.st_size;
+    return true;
+}
+
+MappedFile::~MappedFile() {
+    if(data != nullptr) munmap((void*) data, size);
+}
+
+bool StateReader::open(const char* path) {
+    if(!file.open(path) || file.size < 8 || memcmp(file.data, "PCS1", 4)) return false;
+
+    format = readInt(file.data + 4);
+    if(format != RECORD_RANK && format != RECORD_STICKERS) return false;
+
+    const size_t recordSize = format == RECORD_RANK ? 4 : 12;
+    count = (file.size - 8) / recordSize;
+    truncated = (file.size - 8) % recordSize != 0;
+    return true;
+}
+
+// hasColors (helper): checks that every sticker is a color ID (the state may still be invalid)
+bool hasColors(const PocketCube& c) {
+    for(const short& face : c.state) {
+        for(int cell = 0; cell < 4; cell++) {
+            if(((face >> 4 * cell) & 0b1111) >= 6) return false;
+        }
+    }
+    return true;
+}
+
+// at: reads the ith state into out; returns false (leaving out unspecified) if the record can't
+// be a state: a rank of NUM_RANKS or more, or stickers that aren't all color IDs
+bool StateReader::at(size_t i, PocketCube& out) const {
+    if(format == RECORD_STICKERS) {
+        const byte* record = file.data + 8 + i * 12;
+        for(int face = 0; face < 6; face++) out.state[face] = (short)(record[face * 2] | record[face * 2 + 1] << 8);
+        return hasColors(out);
+    }
+
+    const unsigned int rank = readInt(file.data + 8 + i * 4);
+    if(rank >= NUM_RANKS) return false;
+
+    out = PocketCube::fromCubies(Tables::get().unrank(rank));
+    return true;
+}
+
+bool SolutionReader::open(const char* path) {
+    return file.open(path) && file.size >= 4 && !memcmp(file.data, "PCM1", 4);
+}
+
+bool SolutionReader::next(vector<byte>& path, bool& solved) {
+    if(position >= file.size) return false;
+
+    const byte length = file.data[position++];
+    path.clear();
+    solved = length != UNSOLVED_RECORD;
+    if(!solved) return true;
+
+    if(file.size - position < (size_t)(length + 1) / 2) {
+        truncated = true;
+        return false;
+    }
+    for(int i = 0; i < length; i++) path.push_back(file.data[position + i / 2] >> 4 * (i % 2) & 0xF);
+
+    position += (length + 1) / 2;
+    return true;
+}
+
+/* ~ ~ ~ ~ Writing ~ ~ ~ ~ */
+
+bool BlockWriter::open(const char* path) {
+    file = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+    buffer.reserve(WRITE_BLOCK_SIZE);
+    return file != nullptr;
+}
+
+void BlockWriter::write(const string& bytes) {
+    buffer += bytes;
+    if(buffer.size() < WRITE_BLOCK_SIZE) return;
+
+    failed |= fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size();
+    buffer.clear();
+}
+
+bool BlockWriter::close() {
+    if(file == nullptr) return false;
+
+    failed |= fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size();
+    failed |= (file == stdout ? fflush(file) : fclose(file)) != 0;
+    buffer.clear();
+    file = nullptr;
+    return !failed;
+}
+
+BlockWriter::~BlockWriter() {
+    if(file != nullptr) close();
+}
@@ -0,0 +1,66 @@
+#include "solver.h"
+
+#include <map>
+#include <mutex>
+
+/* ~ ~ ~ ~ Scrambling ~ ~ ~ ~ */
+
+// statesAtDepth (helper):
+// returns every coordinate at exactly the given distance, found by a breadth-first search that
+// only follows turns whose distance is one more (mod 3). Each depth is searched once per process.
+const vector<int>& statesAtDepth(int depth) {
+    static std::mutex mutex;
+    static std::map<int, vector<int>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = cache.find(depth);
+    if(cached != cache.end()) return cached->second;
+
+    const Tables& tables = Tables::get();
+    vector<bool> seen(NUM_STATES, false);
+    vector<int> layer = {0}, next;
+    seen[0] = true;
+
+    for(int d = 0; d < depth; d++) {
+        next.clear();
+        for(const int& index : layer) {
+            for(int m = 0; m < 6; m++) {
+                int neigh = tables.move(index, m);
+                if(seen[neigh] || tables.distanceMod3(neigh) != (d + 1) % 3) continue;
+                seen[neigh] = true;
+                next.push_back(neigh);
+            }
+        }
+        layer.swap(next);
+    }
+
+    return cache[depth] = layer;
+}
+
+// constructor (seed)
+Scrambler::Scrambler(unsigned long long seed): rng(seed) { }
+
+// next:
+// samples a state uniformly at random (among all of them, or among those exactly depth turns from
+// solved), and writes the inverse of its optimal solution (an optimal scramble) into scramble;
+// returns -1 (writing nothing) if depth isn't -1 or in [0, MAX_FIXED_DEPTH]
+int Scrambler::next(byte* scramble, int depth) {
+    TRACE_SCOPE("Scrambler::next");
+    if(depth < -1 || depth > MAX_FIXED_DEPTH) return -1;
+
+    const Tables& tables = Tables::get();
+    int index;
+
+    if(depth == -1) {
+        index = std::uniform_int_distribution<int>(0, NUM_STATES - 1)(rng);
+    } else {
+        const vector<int>& candidates = statesAtDepth(depth);
+        index = candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(rng)];
+    }
+
+    byte solution[MAX_FIXED_DEPTH];
+    const int length = tables.descend(index, solution);
+    for(int i = 0; i < length; i++) scramble[i] = inverse(solution[length - 1 - i]);
+
+    return length;
+}
@@ -6,12 +6,82 @@ const CANVAS_HEIGHT = 300;
 Module.onRuntimeInitialized = function() { main(); }; // run main once WASM is ready
 
 function main() {
+    tracing = _traceEnabled() == 1;
     _init();
     canvas.setAttribute("width", "" + CANVAS_WIDTH);
     canvas.setAttribute("height", "" + CANVAS_HEIGHT);
     cubeMeshSetup();
     updateCubeMesh();
+    update(); // (draw the first frame before doing anything else)
     setInterval(update, 125);
+    setTimeout(prepareTablesInSlices, 0);
+}
+
+// (in ms) the longest the solver tables are built for at once, before yielding to the page
+const TABLE_SLICE_MS = 8;
+
+// prepareTablesInSlices: builds the solver tables (used by scrambling, and by solving when
+// there is no worker) a slice at a time, so page loading and drawing are never blocked for long
+let tablesReady = false;
+
+function prepareTablesInSlices() {
+    tablesReady = _prepareTables(TABLE_SLICE_MS) == 1;
+    if(!tablesReady) setTimeout(prepareTablesInSlices, 0);
+    else if(solverWorker == null) updateSolution(); // (a solve without a worker waits on the tables)
+}
+
+/* ~ ~ ~ ~ Shared Memory ~ ~ ~ ~ */
+
+// word offsets into the MemoryLayout struct (see solver.h)
+const LAYOUT_FRAMEBUFFER          = 0;
+const LAYOUT_FRAMEBUFFER_SIZE     = 1;
+const LAYOUT_CUBIE_COLORS         = 2;
+const LAYOUT_CUBIE_COLORS_SIZE    = 3;
+const LAYOUT_SOLVE_BUFFER         = 4;
+const LAYOUT_SOLVE_BUFFER_SIZE    = 5;
+const LAYOUT_FRAME_GENERATION     = 6;
+const LAYOUT_STATE_GENERATION     = 7;
+const LAYOUT_SOLVE_GENERATION     = 8;
+const LAYOUT_STATE_BUFFER         = 9;
+const LAYOUT_STATE_BUFFER_SIZE    = 10;
+const LAYOUT_SCRAMBLE_BUFFER      = 11;
+const LAYOUT_SCRAMBLE_BUFFER_SIZE = 12;
+const LAYOUT_STICKER_CHANGES      = 13;
+const LAYOUT_STICKER_CHANGES_SIZE = 14;
+const LAYOUT_MOVE_HINTS           = 15;
+const LAYOUT_MOVE_HINTS_SIZE      = 16;
+const LAYOUT_NUM_WORDS            = 17;
+
+let heapViews = null; // cached views over the WASM heap
+
+/*
+ * memoryViews:
+ * Returns views over the buffers exported by getMemoryLayout(). The buffers never move, so the
+ * views (and the ImageData wrapping the framebuffer) are only rebuilt if the heap's ArrayBuffer
+ * is replaced by memory growth.
+ */
+function memoryViews() {
+    if(heapViews != null && heapViews.heap === Module.HEAPU8.buffer) return heapViews;
+
+    let heap = Module.HEAPU8.buffer;
+    let layout = new Uint32Array(heap, _getMemoryLayout(), LAYOUT_NUM_WORDS);
+
+    heapViews = {
+        heap: heap,
+        layout: layout,
+        imageData: new ImageData(
+            new Uint8ClampedArray(heap, layout[LAYOUT_FRAMEBUFFER], layout[LAYOUT_FRAMEBUFFER_SIZE]),
+            CANVAS_WIDTH
+        ),
+        cubieColors: new Uint8Array(heap, layout[LAYOUT_CUBIE_COLORS], layout[LAYOUT_CUBIE_COLORS_SIZE]),
+        solveBuffer: new Uint8Array(heap, layout[LAYOUT_SOLVE_BUFFER], layout[LAYOUT_SOLVE_BUFFER_SIZE]),
+        state: new Int16Array(heap, layout[LAYOUT_STATE_BUFFER], layout[LAYOUT_STATE_BUFFER_SIZE] / 2),
+        scrambleBuffer: new Uint8Array(heap, layout[LAYOUT_SCRAMBLE_BUFFER], layout[LAYOUT_SCRAMBLE_BUFFER_SIZE]),
+        stickerChanges: new Uint8Array(heap, layout[LAYOUT_STICKER_CHANGES], layout[LAYOUT_STICKER_CHANGES_SIZE]),
+        moveHints: new Uint8Array(heap, layout[LAYOUT_MOVE_HINTS], layout[LAYOUT_MOVE_HINTS_SIZE])
+    };
+
+    return heapViews;
 }
 
 /* ~ ~ ~ ~ Graphics ~ ~ ~ ~ */
@@ -51,19 +121,19 @@ class Frame {
     }
 }
 
+let lastFrameGeneration = -1;
+
 function drawFrame() {
     _draw(); // call draw from WASM
 
-    imageData = new ImageData(
-        new Uint8ClampedArray(
-            Module.HEAPU32.buffer,
-            _getImageDataBuffer(),
-            4 * CANVAS_WIDTH * CANVAS_HEIGHT
-        ),
-        CANVAS_WIDTH
-    );
+    let views = memoryViews();
+    let frameGeneration = views.layout[LAYOUT_FRAME_GENERATION];
+    if(frameGeneration == lastFrameGeneration) return; // nothing new was rendered
 
-    ctx.putImageData(imageData, 0, 0);
+    lastFrameGeneration = frameGeneration;
+    let start = traceStart();
+    ctx.putImageData(views.imageData, 0, 0);
+    traceEnd("putImageData", start);
 }
 
 let xRot = -0.15;
@@ -118,9 +188,11 @@ const ORIENT_UP = 2;
 const ORIENT_DOWN = 3;
 
 function turn(turnId) {
+    let start = traceStart();
     _executeTurn(turnId);
     updateCubeMesh();
     updateSolution();
+    traceEnd("turn", start);
 }
 
 function orient(orientationId) {
@@ -150,6 +222,11 @@ const cubeMeshTable = document.getElementById("cube-mesh");
 const TABLE_WIDTH = 8;
 const TABLE_HEIGHT = 6;
 
+// (row, column) of each face's top-left cell in the net: U, L, F, R, B, D
+const MESH_FACE_ORIGINS = [[0, 2], [2, 0], [2, 2], [2, 4], [2, 6], [4, 2]];
+
+let meshCells = []; // the cell of each sticker, in cubie color order (face by face, left-to-right, top-to-bottom)
+
 function cubeMeshSetup() {
     for(let r = 0; r < TABLE_HEIGHT; r++) {
         let row = document.createElement("tr");
@@ -159,69 +236,76 @@ function cubeMeshSetup() {
         }
         cubeMeshTable.appendChild(row);
     }
-}
 
-const mesh = document.querySelector("table");
+    for(let i = 0; i < 24; i++) {
+        let [row, col] = MESH_FACE_ORIGINS[Math.floor(i / 4)];
+        meshCells.push(cubeMeshTable.children[row + (i % 4 >> 1)].children[col + i % 2]);
+    }
+}
 
+// updateCubeMesh: recolors the cells of the stickers that changed since the last update
 function updateCubeMesh() {
-    let colorData = new Uint8ClampedArray(
-                    Module.HEAPU32.buffer,
-                    _getCubieColors(),
-                    24);
-
-    // U
-    mesh.children[0].children[2].bgColor = colorIdToString(colorData[0]);
-    mesh.children[0].children[3].bgColor = colorIdToString(colorData[1]);
-    mesh.children[1].children[2].bgColor = colorIdToString(colorData[2]);
-    mesh.children[1].children[3].bgColor = colorIdToString(colorData[3]);
-
-    // L
-    mesh.children[2].children[0].bgColor = colorIdToString(colorData[4]);
-    mesh.children[2].children[1].bgColor = colorIdToString(colorData[5]);
-    mesh.children[3].children[0].bgColor = colorIdToString(colorData[6]);
-    mesh.children[3].children[1].bgColor = colorIdToString(colorData[7]);
-
-    // F
-    mesh.children[2].children[2].bgColor = colorIdToString(colorData[8]);
-    mesh.children[2].children[3].bgColor = colorIdToString(colorData[9]);
-    mesh.children[3].children[2].bgColor = colorIdToString(colorData[10]);
-    mesh.children[3].children[3].bgColor = colorIdToString(colorData[11]);
-
-    // R
-    mesh.children[2].children[4].bgColor = colorIdToString(colorData[12]);
-    mesh.children[2].children[5].bgColor = colorIdToString(colorData[13]);
-    mesh.children[3].children[4].bgColor = colorIdToString(colorData[14]);
-    mesh.children[3].children[5].bgColor = colorIdToString(colorData[15]);
-
-    // B
-    mesh.children[2].children[6].bgColor = colorIdToString(colorData[16]);
-    mesh.children[2].children[7].bgColor = colorIdToString(colorData[17]);
-    mesh.children[3].children[6].bgColor = colorIdToString(colorData[18]);
-    mesh.children[3].children[7].bgColor = colorIdToString(colorData[19]);
-
-    // D
-    mesh.children[4].children[2].bgColor = colorIdToString(colorData[20]);
-    mesh.children[4].children[3].bgColor = colorIdToString(colorData[21]);
-    mesh.children[5].children[2].bgColor = colorIdToString(colorData[22]);
-    mesh.children[5].children[3].bgColor = colorIdToString(colorData[23]);
+    let start = traceStart();
+    let numChanges = _getStickerChanges();
+    let views = memoryViews();
+
+    for(let i = 0; i < numChanges; i++) {
+        let sticker = views.stickerChanges[i];
+        meshCells[sticker].bgColor = colorIdToString(views.cubieColors[sticker]);
+    }
+
+    traceEnd("updateCubeMesh", start);
 }
 
 const solveCheckbox = document.getElementById("solve-checkbox");
 const solutionTextBox = document.getElementById("solution-box");
 
 function updateSolution() {
+    showMoveHints(null, -1); // (the hints arrive with the solution)
 
     if(!solveCheckbox.checked) {
+        solveRequestId++; // drop any solve that is still in progress
         solutionTextBox.innerHTML = " (Check \"Solve\" To Find Solution) ";
         return;
     }
 
-    let numMoves = _solveCube(); // solve the cube and get the number of moves in the solution
-    let solution = new Uint8ClampedArray(
-                    Module.HEAPU32.buffer,
-                    _getSolveBuffer(),
-                    numMoves);
+    if(solverWorker == null && tablesReady) { // no worker available: solve on the main thread
+        let numMoves = _solveCube(); // solve the cube and get the number of moves in the solution
+        showSolution(memoryViews().solveBuffer.subarray(0, numMoves));
+        let distance = _getMoveHints(); // (well under a millisecond, as the tables are ready)
+        showMoveHints(memoryViews().moveHints, distance);
+        return;
+    }
 
+    if(solverWorker == null) { // (and no tables yet): prepareTablesInSlices solves once they're ready
+        solutionTextBox.innerHTML = " (Solving...) ";
+        return;
+    }
+
+    requestSolve();
+}
+
+const turnButtons = document.querySelectorAll("#turns button"); // (in turn ID order)
+
+// showMoveHints: marks each turn button by whether its turn leads closer to solved or farther,
+// given the distance after each turn (hints[turnID]) and the current distance; clears the marks if
+// hints is null
+function showMoveHints(hints, distance) {
+    let showHints = hints != null && distance >= 0;
+
+    for(let tid = 0; tid < turnButtons.length; tid++) {
+        turnButtons[tid].classList.toggle("closer-move", showHints && hints[tid] < distance);
+        turnButtons[tid].classList.toggle("farther-move", showHints && hints[tid] > distance);
+    }
+}
+
+function showSolution(solution) {
+    if(solution == null) {
+        solutionTextBox.innerHTML = " (Invalid State) ";
+        return;
+    }
+
+    let numMoves = solution.length;
     let solutionString = numMoves == 0 ? "(Solved)" : "";
 
     for(let i = 0; i < numMoves; i++) {
@@ -232,12 +316,192 @@ function updateSolution() {
     solutionTextBox.innerHTML = solutionString;
 }
 
-const SCRAMBLE_NUM_MOVES = 50;
+/* ~ ~ ~ ~ Solver Worker ~ ~ ~ ~ */
+
+// a solve that has run for longer than this (in ms) is cancelled (by restarting the worker)
+// when a newer request is made
+const SOLVE_CANCEL_MS = 250;
+
+let solveRequestId = 0;        // ID of the newest request; responses to older requests are dropped
+let solveInFlightSince = null; // time at which the oldest unanswered request was sent
+let pendingBatches = {};       // batchId -> {states, callback} of every unanswered solveStates() call
+let nextBatchId = 0;
+let solverWorker = startSolverWorker();
+
+function startSolverWorker() {
+    try {
+        let worker = new Worker("src/solver-worker.js");
+
+        worker.onmessage = function(e) {
+            if(e.data.trace !== undefined) receiveWorkerTrace(e.data);
+            else if(e.data.batchId !== undefined) receiveBatch(e.data);
+            else receiveSolution(e.data);
+        };
+        worker.onerror = function() { // (e.g. workers are unavailable on file://): fall back to solving inline
+            worker.terminate();
+            solverWorker = null;
+            updateSolution();
+            for(let batchId in pendingBatches) solveBatchInline(pendingBatches[batchId], []);
+            pendingBatches = {};
+        };
+
+        for(let batchId in pendingBatches) { // (resend the batches a cancelled worker didn't finish)
+            worker.postMessage({batchId: batchId, states: pendingBatches[batchId].states});
+        }
+
+        return worker;
+    } catch(e) {
+        return null;
+    }
+}
+
+function requestSolve() {
+    let now = performance.now();
+
+    if(solveInFlightSince != null && now - solveInFlightSince > SOLVE_CANCEL_MS) {
+        solverWorker.terminate(); // cancel the stale solve
+        solverWorker = startSolverWorker();
+        if(solverWorker == null) return updateSolution();
+        solveInFlightSince = null;
+    }
+
+    _saveState();
+    let id = ++solveRequestId;
+    solverWorker.postMessage({id: id, state: memoryViews().state.slice()});
+
+    if(solveInFlightSince == null) solveInFlightSince = now;
+    solutionTextBox.innerHTML = " (Solving...) ";
+}
+
+function receiveSolution(response) {
+    if(response.id != solveRequestId) { // the cube has changed since this request was made
+        solveInFlightSince = performance.now(); // (the worker has moved on to a newer request)
+        return;
+    }
+
+    solveInFlightSince = null;
+
+    showSolution(response.moves);
+    showMoveHints(response.hints, response.distance);
+}
+
+/*
+ * solveStates:
+ * Solves a list of states (an Int16Array holding copies of PocketCube::state back to back, 6
+ * values per state), then calls callback with their solutions (arrays of turn IDs, or null for
+ * invalid states). The states are solved by the worker (or, without one, on the main thread a
+ * chunk at a time), with one solveMany() call per chunk rather than one call per state.
+ */
+function solveStates(states, callback) {
+    let batch = {states: states, callback: callback};
+
+    if(solverWorker == null) {
+        solveBatchInline(batch, []);
+        return;
+    }
+
+    let batchId = nextBatchId++;
+    pendingBatches[batchId] = batch;
+    solverWorker.postMessage({batchId: batchId, states: states});
+}
+
+function receiveBatch(response) {
+    let batch = pendingBatches[response.batchId];
+    if(batch === undefined) return;
+
+    delete pendingBatches[response.batchId];
+    batch.callback(response.solutions);
+}
+
+// solveBatchInline (helper): solves the batch on the main thread, one chunk per task
+function solveBatchInline(batch, solutions) {
+    let start = traceStart();
+    solveBatchChunk(batch.states, solutions.length, solutions);
+    traceEnd("solveBatchChunk", start);
+
+    if(solutions.length == batch.states.length / 6) batch.callback(solutions);
+    else setTimeout(function() { solveBatchInline(batch, solutions); }, 0);
+}
 
 function scrambleCube() {
-    for(let i = 1; i <= SCRAMBLE_NUM_MOVES; i++) {
-        let turnId = Math.floor(Math.random() * 12); // random int [0, 11] (random TurnId)
-        if(i == SCRAMBLE_NUM_MOVES) turn(turnId);    // only update mesh and solution on last turn
-        else _executeTurn(turnId);                   // otherwise call WASM turn function
+    let start = traceStart();
+    let numMoves = _randomScramble(-1); // optimal scramble of a uniformly random state
+    let scramble = memoryViews().scrambleBuffer;
+
+    for(let i = 0; i < numMoves; i++) _executeTurn(scramble[i]);
+
+    updateCubeMesh(); // only update mesh and solution once
+    updateSolution();
+    traceEnd("scrambleCube", start);
+}
+
+/* ~ ~ ~ ~ Tracing ~ ~ ~ ~ */
+
+// In builds made with -DTRACING, the WASM module records trace events (see Tracing in solver.h);
+// the page then records its own spans too (on the same performance.now() clock, as WASM's steady
+// clock is performance.now() outside of pthread builds). Call downloadTrace() (e.g. from the
+// console) to save everything, including the solver worker's events, as one Chrome trace.
+
+const JS_TRACE_CAPACITY = 1 << 14; // spans kept (the oldest are overwritten first)
+
+let tracing = false;
+let jsTraceEvents = [];
+let jsTraceHead = 0;
+let pendingTrace = null; // events waiting on the worker's, while downloading
+
+function traceStart() {
+    return tracing ? performance.now() : 0;
+}
+
+function traceEnd(name, start) {
+    if(!tracing) return;
+
+    let end = performance.now();
+    jsTraceEvents[jsTraceHead++ % JS_TRACE_CAPACITY] =
+        {name: name, ph: "X", pid: 1, tid: 0, ts: start * 1000, dur: (end - start) * 1000};
+}
+
+// readCString (helper): decodes the null-terminated string at the given address of the heap
+function readCString(address) {
+    let heap = Module.HEAPU8;
+    return new TextDecoder().decode(heap.subarray(address, heap.indexOf(0, address)));
+}
+
+function downloadTrace() {
+    if(!tracing) {
+        console.log("tracing is disabled (rebuild with \"make -B TRACE=1\")");
+        return;
     }
+
+    pendingTrace = JSON.parse(readCString(_exportTrace()));
+    pendingTrace.traceEvents.push(...jsTraceEvents.filter(e => e !== undefined));
+
+    if(solverWorker == null) saveTrace([]);
+    else solverWorker.postMessage({trace: true});
+}
+
+// receiveWorkerTrace: adds the worker's events (shifted onto the page's clock, as process 2)
+function receiveWorkerTrace(response) {
+    let shift = (response.timeOrigin - performance.timeOrigin) * 1000;
+    let events = JSON.parse(response.trace).traceEvents;
+
+    for(let e of events) {
+        e.pid = 2;
+        e.ts += shift;
+    }
+
+    saveTrace(events);
+}
+
+function saveTrace(workerEvents) {
+    if(pendingTrace == null) return;
+
+    pendingTrace.traceEvents.push(...workerEvents);
+    let link = document.createElement("a");
+    link.href = URL.createObjectURL(new Blob([JSON.stringify(pendingTrace)], {type: "application/json"}));
+    link.download = "pocket-cube-trace.json";
+    link.click();
+    URL.revokeObjectURL(link.href);
+
+    pendingTrace = null;
 }
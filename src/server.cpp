@@ -0,0 +1,324 @@
+#include "solver.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * solve-server: a long-running daemon that answers solve requests over a Unix domain socket.
+ *
+ *   usage: solve-server <socket path> [--threads N] [--length-prefixed]
+ *
+ * Each request is a state as 24 color characters (see PocketCube::parse); each response is its
+ * solution as space-separated move names (empty if already solved), or "ERR <reason>".
+ * Requests and responses are framed by newlines, or (with --length-prefixed) preceded by their
+ * length as a 4-byte little-endian integer.
+ *
+ * Clients may send any number of requests without waiting: every connection has a reader thread
+ * that feeds a shared queue, worker threads take the queued requests in batches, and every
+ * connection has a writer thread that sends its responses in the order its requests were
+ * received. Workers never wait on a client: a client that stops reading only stalls its own
+ * writer, and then its own reader (once its unsent responses pass MAX_UNSENT_BYTES). Readers
+ * also wait while the shared queue holds MAX_QUEUED_REQUESTS.
+ */
+
+constexpr int MAX_BATCH_SIZE = 64;     // requests taken from the queue at once
+constexpr size_t MAX_REQUEST_SIZE = 1024;
+constexpr size_t MAX_QUEUED_REQUESTS = 1 << 16; // requests waiting for a worker (all connections)
+constexpr size_t MAX_UNSENT_BYTES = 1 << 20;    // responses waiting for a connection's writer
+
+/* ~ ~ ~ ~ Connections ~ ~ ~ ~ */
+
+struct Connection {
+    const int fd;
+    const bool lengthPrefixed;
+
+    std::mutex mutex;                    // guards the fields below (but not writes to fd)
+    std::condition_variable changed;     // notified whenever any of them change
+    unsigned long long nextResponse = 0; // sequence number of the next response to send
+    std::map<unsigned long long, string> finished; // responses waiting on an earlier one
+    string unsent;                       // framed responses, in order, for the writer to send
+    unsigned long long outstanding = 0;  // requests read but not yet answered
+    bool readerDone = false;             // the client has stopped sending requests
+    bool failed = false;                 // a write failed (the client went away)
+
+    Connection(int fd, bool lengthPrefixed): fd(fd), lengthPrefixed(lengthPrefixed) { }
+    ~Connection() { close(fd); } // (closed once the reader, the writer and every pending request are done)
+
+    void respond(const vector<std::pair<unsigned long long, string>>& responses);
+};
+
+// frame (helper): appends the framed message to out
+void frame(const string& message, bool lengthPrefixed, string& out) {
+    if(lengthPrefixed) {
+        unsigned int length = message.size();
+        for(int i = 0; i < 4; i++) out.push_back((char)(length >> 8 * i));
+        out += message;
+    } else {
+        out += message;
+        out.push_back('\n');
+    }
+}
+
+// respond: records the given (sequence number, response) pairs, and hands every response that
+// is now next in line to the writer (without waiting for it to be sent)
+void Connection::respond(const vector<std::pair<unsigned long long, string>>& responses) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(const auto& response : responses) finished[response.first] = response.second;
+    outstanding -= responses.size();
+
+    while(!finished.empty() && finished.begin()->first == nextResponse) {
+        if(!failed) frame(finished.begin()->second, lengthPrefixed, unsent); // (else dropped)
+        finished.erase(finished.begin());
+        nextResponse++;
+    }
+
+    changed.notify_all();
+}
+
+// writer: sends the connection's responses (outside of the lock, so that workers never wait on
+// the client) until the client has stopped sending and every response is sent, or a write fails
+void writer(std::shared_ptr<Connection> connection) {
+    string out;
+    std::unique_lock<std::mutex> lock(connection->mutex);
+
+    while(true) {
+        connection->changed.wait(lock, [&]{
+            return !connection->unsent.empty() || (connection->readerDone && connection->outstanding == 0);
+        });
+        if(connection->unsent.empty()) return;
+
+        out.clear();
+        out.swap(connection->unsent);
+        connection->changed.notify_all(); // (a reader may be waiting for room)
+        lock.unlock();
+
+        bool failed = false;
+        for(size_t written = 0; written < out.size() && !failed; ) {
+            ssize_t n = write(connection->fd, out.data() + written, out.size() - written);
+            failed = n <= 0;
+            if(!failed) written += n;
+        }
+
+        lock.lock();
+        if(!failed) continue;
+
+        connection->failed = true; // (the client went away; its remaining responses are dropped)
+        connection->unsent.clear();
+        connection->changed.notify_all();
+        shutdown(connection->fd, SHUT_RDWR); // (ends the reader too)
+        return;
+    }
+}
+
+/* ~ ~ ~ ~ Request Queue ~ ~ ~ ~ */
+
+struct Request {
+    std::shared_ptr<Connection> connection;
+    unsigned long long sequence;
+    string state;
+};
+
+std::mutex queueMutex;
+std::condition_variable queueNotEmpty;
+std::condition_variable queueNotFull;
+std::deque<Request> requestQueue;
+
+// enqueue: adds the requests to the queue, first waiting (as long as needed) for it to have
+// room below MAX_QUEUED_REQUESTS
+void enqueue(vector<Request>& requests) {
+    if(requests.empty()) return;
+
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueNotFull.wait(lock, []{ return requestQueue.size() < MAX_QUEUED_REQUESTS; });
+        for(Request& request : requests) requestQueue.push_back(std::move(request));
+    }
+
+    requests.clear();
+    queueNotEmpty.notify_all();
+}
+
+// takeBatch: waits for requests, then takes up to MAX_BATCH_SIZE of them
+void takeBatch(vector<Request>& batch) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueNotEmpty.wait(lock, []{ return !requestQueue.empty(); });
+
+    while(!requestQueue.empty() && batch.size() < MAX_BATCH_SIZE) {
+        batch.push_back(std::move(requestQueue.front()));
+        requestQueue.pop_front();
+    }
+
+    queueNotFull.notify_all();
+}
+
+/* ~ ~ ~ ~ Solving ~ ~ ~ ~ */
+
+const char* const stateErrors[6] = {"valid", "bad format", "bad color count", "bad corner",
+                                    "duplicate corner", "twisted corner"};
+
+// answer: solves the given state (text) and returns the response
+string answer(const string& text, SolverContext& context) {
+    PocketCube c;
+    int status = PocketCube::parse(text, c);
+    if(status != STATE_VALID) return string("ERR ") + stateErrors[status];
+
+    const SolveResult& result = solveWithTables(context, c, SolveOptions{});
+    if(result.status != SOLVE_OPTIMAL) return "ERR unsolved";
+
+    string response;
+    for(const byte& tid : result.path) {
+        if(!response.empty()) response.push_back(' ');
+        response += moveNames[tid];
+    }
+
+    return response;
+}
+
+// worker: solves batches of requests, delivering each connection's responses from a batch at once
+void worker() {
+    vector<Request> batch;
+    vector<std::pair<unsigned long long, string>> responses;
+    SolverContext context; // (every worker has its own)
+
+    while(true) {
+        batch.clear();
+        takeBatch(batch);
+
+        std::stable_sort(batch.begin(), batch.end(), [](const Request& a, const Request& b) {
+            return a.connection < b.connection;
+        });
+
+        for(size_t i = 0; i < batch.size(); i++) {
+            responses.emplace_back(batch[i].sequence, answer(batch[i].state, context));
+            if(i + 1 < batch.size() && batch[i + 1].connection == batch[i].connection) continue;
+
+            batch[i].connection->respond(responses);
+            responses.clear();
+        }
+    }
+}
+
+/* ~ ~ ~ ~ Reading ~ ~ ~ ~ */
+
+// readRequests (helper): splits everything received on the connection into requests, queuing all
+// of the requests from one read together; returns when the client stops sending (or breaks the
+// protocol, or the connection fails)
+void readRequests(const std::shared_ptr<Connection>& connection) {
+    string buffer;
+    vector<Request> requests;
+    unsigned long long sequence = 0;
+    char chunk[1 << 16];
+
+    while(true) {
+        { // (wait until the writer has caught up with a client that isn't reading)
+            std::unique_lock<std::mutex> lock(connection->mutex);
+            connection->changed.wait(lock, [&]{
+                return connection->unsent.size() < MAX_UNSENT_BYTES || connection->failed;
+            });
+            if(connection->failed) return;
+        }
+
+        ssize_t n = read(connection->fd, chunk, sizeof(chunk));
+        if(n <= 0) break;
+        buffer.append(chunk, n);
+
+        size_t start = 0;
+        while(true) {
+            size_t length, payload;
+
+            if(connection->lengthPrefixed) {
+                if(buffer.size() - start < 4) break;
+                length = 0;
+                for(int i = 0; i < 4; i++) length |= (size_t)(unsigned char) buffer[start + i] << 8 * i;
+                payload = start + 4;
+                if(length > MAX_REQUEST_SIZE) return;
+                if(buffer.size() - payload < length) break;
+            } else {
+                size_t end = buffer.find('\n', start);
+                if(end == string::npos) {
+                    if(buffer.size() - start > MAX_REQUEST_SIZE) return;
+                    break;
+                }
+                length = end - start;
+                payload = start;
+            }
+
+            requests.push_back({connection, sequence++, buffer.substr(payload, length)});
+            start = payload + length + !connection->lengthPrefixed;
+        }
+
+        buffer.erase(0, start);
+
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->outstanding += requests.size();
+        }
+        enqueue(requests);
+    }
+}
+
+// reader: reads the connection's requests, then lets its writer finish once they're answered
+void reader(std::shared_ptr<Connection> connection) {
+    std::thread(writer, connection).detach();
+    readRequests(connection);
+
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->readerDone = true;
+    connection->changed.notify_all();
+}
+
+/* ~ ~ ~ ~ Main ~ ~ ~ ~ */
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <socket path> [--threads N] [--length-prefixed]\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[1];
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool lengthPrefixed = false;
+
+    for(int i = 2; i < argc; i++) {
+        if(!strcmp(argv[i], "--threads") && i + 1 < argc) numThreads = std::max(1, atoi(argv[++i]));
+        else if(!strcmp(argv[i], "--length-prefixed")) lengthPrefixed = true;
+        else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN); // (a client that disconnects early shouldn't kill the server)
+    Tables::get();            // build the tables once, before accepting anything
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+
+    if(listener < 0 || bind(listener, (sockaddr*) &address, sizeof(address)) < 0 || listen(listener, 128) < 0) {
+        perror("solve-server");
+        return 1;
+    }
+
+    for(int i = 0; i < numThreads; i++) std::thread(worker).detach();
+    fprintf(stderr, "solve-server: listening on %s (%d threads)\n", path, numThreads);
+
+    while(true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if(fd < 0) continue;
+        std::thread(reader, std::make_shared<Connection>(fd, lengthPrefixed)).detach();
+    }
+}
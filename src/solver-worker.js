@@ -0,0 +1,118 @@
+/*
+ * solver-worker.js:
+ * Hosts a second instance of the WASM module so that solving never blocks the page.
+ *
+ * request:  {id, state}  (state = Int16Array(6), a copy of PocketCube::state)
+ * response: {id, moves, hints, distance}  (moves = array of turn IDs, or null if the state is
+ *           invalid; hints = the distance after each turn (by turn ID), and distance = that of the
+ *           state, as getMoveHints() returns them; hints is null if the state is invalid)
+ *
+ * Requests that arrive while a solve is in progress are coalesced: only the newest one is
+ * solved, the others are dropped without a response.
+ *
+ * request:  {batchId, states}  (states = Int16Array(6 * n), n copies of PocketCube::state back to back)
+ * response: {batchId, solutions}  (solutions = n arrays of turn IDs, or null for invalid states)
+ *
+ * Batches are never dropped. They are solved in order, a chunk (see batch.js) at a time, and
+ * any pending single request is solved between chunks.
+ *
+ * request:  {trace: true}
+ * response: {trace, timeOrigin}  (trace = the module's exportTrace() JSON)
+ */
+
+// word offsets into the MemoryLayout struct (see solver.h)
+const LAYOUT_SOLVE_BUFFER = 4;
+const LAYOUT_STATE_BUFFER = 9;
+const LAYOUT_MOVE_HINTS   = 15;
+const LAYOUT_NUM_WORDS    = 17;
+
+const STATE_VALID = 0; // (see STATE_* codes in solver.h)
+
+// (in ms) the longest the solver tables are built for at once, before checking for requests
+const TABLE_SLICE_MS = 8;
+
+let ready = false;           // true once the WASM runtime is initialized
+let latestRequest = null;    // newest request that hasn't been solved yet
+let batches = [];            // batch requests that haven't been answered, oldest first
+let batchSolutions = [];     // solutions of batches[0] found so far
+
+var Module = {
+    locateFile: function(path) { return "../bin/" + path; }, // wasm.wasm lives next to wasm.js
+    onRuntimeInitialized: function() {
+        ready = true;
+        solveLatest();
+        solveBatches();
+        prepareTablesInSlices();
+    }
+};
+
+importScripts("../bin/wasm.js", "batch.js");
+
+/* ~ ~ ~ ~ Solving ~ ~ ~ ~ */
+
+// prepareTablesInSlices: builds the tables ahead of the first request, a slice at a time (a
+// request that arrives first finishes them itself)
+function prepareTablesInSlices() {
+    if(!_prepareTables(TABLE_SLICE_MS)) setTimeout(prepareTablesInSlices, 0);
+}
+
+onmessage = function(e) {
+    if(e.data.trace) {
+        let trace = "{\"traceEvents\":[]}";
+        if(ready) {
+            let address = _exportTrace();
+            let heap = Module.HEAPU8;
+            trace = new TextDecoder().decode(heap.subarray(address, heap.indexOf(0, address)));
+        }
+
+        postMessage({trace: trace, timeOrigin: performance.timeOrigin});
+        return;
+    }
+
+    if(e.data.batchId !== undefined) {
+        batches.push(e.data);
+        if(ready && batches.length == 1) setTimeout(solveBatches, 0);
+        return;
+    }
+
+    latestRequest = e.data;
+    if(ready) setTimeout(solveLatest, 0); // let any other queued requests arrive first
+};
+
+function solveLatest() {
+    if(latestRequest == null) return;
+
+    let request = latestRequest;
+    latestRequest = null;
+
+    let layout = new Uint32Array(Module.HEAPU8.buffer, _getMemoryLayout(), LAYOUT_NUM_WORDS);
+    new Int16Array(Module.HEAPU8.buffer, layout[LAYOUT_STATE_BUFFER], 6).set(request.state);
+    if(_loadState() != STATE_VALID) { // (reject states that can't be solved before searching)
+        postMessage({id: request.id, moves: null, hints: null, distance: -1});
+        return;
+    }
+
+    let numMoves = _solveCube();
+    let moves = Array.from(new Uint8Array(Module.HEAPU8.buffer, layout[LAYOUT_SOLVE_BUFFER], numMoves));
+    let distance = _getMoveHints(); // (the tables are ready now, so this takes well under a millisecond)
+    let hints = Array.from(new Uint8Array(Module.HEAPU8.buffer, layout[LAYOUT_MOVE_HINTS], 12));
+
+    postMessage({id: request.id, moves: moves, hints: hints, distance: distance});
+}
+
+// solveBatches: solves one chunk of the oldest batch (answering it once it's done), then yields
+// so that newer single requests aren't held up
+function solveBatches() {
+    if(batches.length == 0) return;
+
+    let batch = batches[0];
+    solveBatchChunk(batch.states, batchSolutions.length, batchSolutions);
+
+    if(batchSolutions.length == batch.states.length / 6) {
+        postMessage({batchId: batch.batchId, solutions: batchSolutions});
+        batches.shift();
+        batchSolutions = [];
+    }
+
+    if(batches.length > 0) setTimeout(solveBatches, 0);
+}
@@ -1,11 +1,17 @@
 #ifndef SOLVER
 #define SOLVER
 
+#include <string>
 #include <vector>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <cmath>
+#include <random>
+#include <cstdio>
 
 using std::string;
 using std::vector;
@@ -59,6 +65,9 @@ const byte R = 3;
 const byte B = 4;
 const byte D = 5;
 
+// oppositeFaces: the face across the cube from each face
+const byte oppositeFaces[6] = {D, R, B, L, F, U};
+
 // Cubie Location IDs (the funny indexing is so bitwise shifts can be used to rotate entire faces)
 //  23
 //  10
@@ -67,6 +76,33 @@ const byte BOT_LEFT  = 1;
 const byte TOP_LEFT  = 2;
 const byte TOP_RIGHT = 3;
 
+// logicalCells: cell IDs in the order used by text and the 2d net (getCubieColors): ( 0 1 )
+//                                                                                  ( 2 3 )
+const byte logicalCells[4] = {TOP_LEFT, TOP_RIGHT, BOT_LEFT, BOT_RIGHT};
+
+// Corner Location IDs
+const byte UFR = 0;
+const byte UFL = 1;
+const byte UBL = 2;
+const byte UBR = 3;
+const byte DFR = 4;
+const byte DFL = 5;
+const byte DBL = 6;
+const byte DBR = 7;
+
+// cornerFacelets: the (face ID, cell ID) of each corner location's three stickers, listed
+// clockwise starting from the U/D sticker
+const byte cornerFacelets[8][3][2] = {
+    {{U, BOT_RIGHT}, {R, TOP_LEFT},  {F, TOP_RIGHT}}, // UFR
+    {{U, BOT_LEFT},  {F, TOP_LEFT},  {L, TOP_RIGHT}}, // UFL
+    {{U, TOP_LEFT},  {L, TOP_LEFT},  {B, TOP_RIGHT}}, // UBL
+    {{U, TOP_RIGHT}, {B, TOP_LEFT},  {R, TOP_RIGHT}}, // UBR
+    {{D, TOP_RIGHT}, {F, BOT_RIGHT}, {R, BOT_LEFT}},  // DFR
+    {{D, TOP_LEFT},  {L, BOT_RIGHT}, {F, BOT_LEFT}},  // DFL
+    {{D, BOT_LEFT},  {B, BOT_RIGHT}, {L, BOT_LEFT}},  // DBL
+    {{D, BOT_RIGHT}, {R, BOT_RIGHT}, {B, BOT_LEFT}}   // DBR
+};
+
 // TURN IDs 
 const byte TURN_U  = 0;
 const byte TURN_L  = 1;
@@ -81,6 +117,8 @@ const byte TURN_RP = 9;
 const byte TURN_BP = 10;
 const byte TURN_DP = 11;
 
+const char* const moveNames[12] = {"U", "L", "F", "R", "B", "D", "U'", "L'", "F'", "R'", "B'", "D'"};
+
 byte inverse(const byte tid); // converts a turnID to its inverse turnID (+= 6; %= 12;)
 
 /* ~ ~ ~ ~ Geometric Structures ~ ~ ~ ~ */
@@ -152,6 +190,37 @@ struct POV {
     Point rectRaycast(const Rect& r, const double x, const double y) const; // finds the collision of the rect and the viewpoint ray
 };
 
+/* ~ ~ ~ ~ Vectorized Raycasting ~ ~ ~ ~ */
+
+// number of pixels processed per kernel iteration (one 128-bit register of doubles under
+// -msimd128 or SSE2, two under AVX)
+#ifdef __AVX__
+constexpr int LANES = 4;
+#else
+constexpr int LANES = 2;
+#endif
+
+typedef double doubleLanes __attribute__((vector_size(LANES * sizeof(double))));
+typedef long long maskLanes __attribute__((vector_size(LANES * sizeof(long long))));
+
+struct FaceKernel {
+    double A, B, C, D;          // plane equation (Ax + By + Cz = D)
+    double cx[4], cy[4], cz[4]; // corner coordinates
+    double ex[4], ey[4], ez[4]; // edge vectors (corner[k] - corner[k + 1])
+    long long colors[4];        // corner colors
+
+    FaceKernel(const Rect& r); // constructor (precomputes the rect's per-frame constants)
+};
+
+struct RayKernel {
+    vector<FaceKernel> faces;
+    Point viewpoint;
+    double halfWidth, halfHeight, setback;
+
+    RayKernel(const POV& pov, const vector<Rect>& faces); // constructor
+    void renderRow(int *row, const int width, const double y) const; // raycasts one row of pixels into row[0..width)
+};
+
 struct Cube {
     vector<Point> corners;
 
@@ -167,14 +236,38 @@ struct Cube {
 
 /* ~ ~ ~ ~ Cube Interface ~ ~ ~ ~ */
 
+// State validation codes
+const int STATE_VALID            = 0;
+const int STATE_BAD_FORMAT       = 1; // (text) wrong number of stickers or unknown color character
+const int STATE_BAD_COLOR_COUNT  = 2; // some color doesn't appear exactly 4 times
+const int STATE_BAD_CORNER       = 3; // some corner's stickers don't match any real corner
+const int STATE_DUPLICATE_CORNER = 4; // some real corner appears twice
+const int STATE_TWISTED          = 5; // the corners' twists don't sum to 0 (mod 3)
+
+// CubieCube: the state of the cube as the corner (and its twist) at each corner location
+struct CubieCube {
+    byte corners[8]; // corners[location] = corner ID (the location it occupies when solved)
+    byte twists[8];  // twists[location] = index (0-2) of the corner's U/D sticker within cornerFacelets[location]
+};
+
 class PocketCube {
 public:
-    vector<short> state; // {(U)p, (L)eft, (F)ront, (R)ight, (B)ack, (D)own}
+    std::array<short, 6> state; // {(U)p, (L)eft, (F)ront, (R)ight, (B)ack, (D)own}
 
     static short faceColor(byte topLeft, byte topRight, byte botLeft, byte botRight); // generates a face bitmask with the given colors
     static vector<byte> extractFaceColors(short face); // given a face bitset, the corresponding Color IDs are returned
     static const PocketCube solved; // solved state
 
+    byte sticker(byte face, byte cell) const; // returns the color ID at the given face and cell
+    void setSticker(byte face, byte cell, byte color); // sets the color ID at the given face and cell
+
+    // validation / conversion
+    int toCubies(CubieCube& cubies) const; // converts to cubie form; returns a STATE_* code
+    static PocketCube fromCubies(const CubieCube& cubies); // converts from (valid) cubie form
+    static int parse(const string& text, PocketCube& out); // parses and validates; returns a STATE_* code
+    string toString() const; // 24 color characters, in the same order as parse
+    bool isSolvable() const; // checks that the stickers form 8 real corners whose twists sum to 0 (mod 3)
+
     struct hash {
         size_t operator()(const PocketCube& c) const;
     };
@@ -213,7 +306,315 @@ private:
 
 /* ~ ~ ~ ~ Solving ~ ~ ~ ~ */
 
+// solve statuses
+const int SOLVE_OPTIMAL     = 0; // path is a shortest solution
+const int SOLVE_BEST_SO_FAR = 1; // a limit was reached; path leads to the most-solved state found
+const int SOLVE_UNSOLVABLE  = 2; // the state can't be reached from the solved state (path is empty)
+const int SOLVE_ABORTED     = 3; // a limit was reached before any progress was made (path is empty)
+const int SOLVE_IN_PROGRESS = 4; // (resumable solves) the search is paused; resumeSolve continues it
+
+struct SolveOptions {
+    long long maxNodes = -1;  // maximum number of explored states (-1 = unlimited)
+    double maxTimeMs = -1;    // deadline, in milliseconds after the solve starts (-1 = unlimited)
+    int maxDepth = -1;        // maximum solution length (-1 = unlimited)
+};
+
+struct SolveResult {
+    int status = SOLVE_OPTIMAL; // (a fresh context holds an empty, finished solve)
+    vector<byte> path; // turnIDs
+};
+
+// SolverContext: the scratch memory of the solvers, kept between solves so that repeated solves
+// make no allocations (once the buffers have grown to fit). Clearing it takes O(1): entries of
+// the search trees are only valid if they carry the current epoch. A context must only be used
+// by one thread at a time; separate contexts can be used concurrently.
+class SolverContext {
+public:
+    SolveResult result; // result of the latest solve (its path keeps its capacity between solves)
+
+    // Entry: a state (its stickers packed into 96 bits) and the move that first reached it
+    struct Entry {
+        uint128_t key;
+        unsigned int epoch; // (the entry is empty unless this is the context's current epoch)
+        byte move;          // turnID (NO_MOVE for the root)
+        byte depth;
+    };
+
+    // Tree: one side of the bidirectional search; an open-addressing (linear probing) table of
+    // entries, and the queue of states to explore
+    struct Tree {
+        vector<Entry> entries;  // (capacity is a power of 2)
+        size_t size = 0;        // entries in the current epoch
+        vector<PocketCube> queue;
+        size_t head = 0;        // index of the front of the queue
+    };
+
+    static const byte NO_MOVE = 0xFF;
+
+    Tree trees[2]; // (from the start, from the solved state)
+    unsigned int epoch = 0;
+
+    void reset(); // empties both trees in O(1)
+    Entry* find(Tree& tree, uint128_t key) const; // returns the entry of key (nullptr if absent)
+    void insert(Tree& tree, uint128_t key, byte move, byte depth); // (key must be absent)
+    static uint128_t pack(const PocketCube& c);
+};
+
+PocketCube& turn(PocketCube& c, int turnId); // executes the turn function corresponding to turnId
+const SolveResult& solve(SolverContext& context, const PocketCube& startNode, const SolveOptions& options); // bounded solve
+SolveResult solve(const PocketCube& startNode, const SolveOptions& options); // (with a temporary context)
 vector<byte> solve(const PocketCube& startNode); // returns a vector of turnIDs
+const SolveResult& startSolve(SolverContext& context, const PocketCube& startNode); // resumable solve (see solving.cpp)
+const SolveResult& resumeSolve(SolverContext& context, const SolveOptions& slice); // (bounded by slice's maxNodes and maxTimeMs)
+
+/* ~ ~ ~ ~ Permutations ~ ~ ~ ~ */
+
+// Permutation: a rearrangement of the 24 stickers (sticker i = face * 4 + cell); applying it moves
+// the sticker at from[i] to i. A whole move sequence compiles into one Permutation, so applying
+// (or repeating) an algorithm costs the same as applying a single turn.
+struct Permutation {
+    byte from[24];
+
+    Permutation(); // identity
+
+    static Permutation ofTurn(int turnId); // (derived once from the PocketCube turn methods)
+    static Permutation ofTurns(const vector<byte>& turns); // compiles a sequence of turnIDs
+
+    PocketCube apply(const PocketCube& c) const;
+    Permutation then(const Permutation& next) const; // composition: *this, followed by next
+    Permutation inverse() const;
+    Permutation power(long long k) const; // *this repeated k times (k may be negative), by squaring
+    vector<int> cycleLengths() const; // lengths of the sticker cycles (longer than 1), descending
+    long long order() const; // smallest k > 0 with power(k) == identity
+
+    bool operator==(const Permutation& other) const;
+    bool operator!=(const Permutation& other) const;
+};
+
+// parses move names separated by spaces or commas (half turns such as U2 become two turns);
+// returns false if some move isn't recognized
+bool parseMoves(const string& text, vector<byte>& turns);
+
+/* ~ ~ ~ ~ Tables ~ ~ ~ ~ */
+
+constexpr int NUM_PERMS  = 5040;                   // arrangements of the 7 corners other than DBL
+constexpr int NUM_TWISTS = 729;                    // twists of the 7 corners other than DBL (the 7th is implied)
+constexpr int NUM_STATES = NUM_PERMS * NUM_TWISTS; // 3,674,160 states with DBL solved
+constexpr int NUM_ROTATIONS = 24;                  // whole-cube rotations
+constexpr unsigned int NUM_RANKS = NUM_ROTATIONS * NUM_STATES; // every state, in any orientation
+
+// the turns that leave DBL in place
+const byte FIXED_TURNS[6] = {TURN_U, TURN_R, TURN_F, TURN_UP, TURN_RP, TURN_FP};
+
+// CubieMap: a turn or rotation acting on the cubie form; the corner that ends up at location l
+// comes from location from[l], and its twist increases by delta[l]
+struct CubieMap {
+    byte from[8];
+    byte delta[8];
+
+    CubieCube apply(const CubieCube& c) const;
+    static CubieMap of(const Permutation& p); // the effect of a sticker permutation on the corners
+    static CubieMap ofTurns(const vector<byte>& turns);
+};
+
+// Tables: move and distance tables over the coordinate (perm * NUM_TWISTS + twist) of states with DBL
+// solved. Any other state is brought into that set by a whole-cube rotation (see canonicalIndex); every
+// turn changes that rotated state by one FIXED_TURN, so its distance is a lower bound for the original.
+struct Tables {
+    unsigned short permMoves[NUM_PERMS][6];   // [perm][FIXED_TURNS index]
+    unsigned short twistMoves[NUM_TWISTS][6]; // [twist][FIXED_TURNS index]
+    CubieMap turns[12];                       // [turnID]
+    CubieMap canonicalizers[NUM_ROTATIONS];   // [location of DBL * 3 + its twist]: rotates DBL back home
+    CubieMap rotations[NUM_ROTATIONS];        // [same index]: the inverse (takes DBL to that location and twist)
+    vector<byte> distances;                   // 2 bits per coordinate: distance (quarter turns) mod 3
+
+    static const Tables& get(); // builds the tables on first use (once per process; thread-safe)
+    static bool prepare(double budgetMs); // builds part of the tables, for about budgetMs; returns whether they are ready
+
+    int move(int index, int fixedTurn) const; // applies FIXED_TURNS[fixedTurn] to a coordinate
+    int distanceMod3(int index) const;
+    int distance(int index) const; // exact distance (found by descending the table)
+    int descend(int index, byte* path) const; // writes an optimal solution (of FIXED_TURNS) into path; returns its length
+    int canonicalIndex(const CubieCube& c) const; // coordinate of c rotated so that DBL is solved
+    unsigned int rank(const CubieCube& c) const; // canonicalizer index * NUM_STATES + canonicalIndex (< NUM_RANKS)
+    CubieCube unrank(unsigned int rank) const;
+
+    static int encode(const CubieCube& c); // coordinate of c (DBL must be solved)
+    static CubieCube decode(int index);
+
+private:
+    Tables(); // (fills everything but the distance table)
+    friend struct TableLoader;
+};
+
+// writes the distance table in the compressed form that EMBEDDED_TABLES builds load (and that
+// "make FAST_START=1" embeds); returns false if the file can't be written
+bool writeCompressedTables(const char* path);
+
+// IDASearch: what the iterative-deepening searches over the tables (solveWithTables, solveToGoal) share:
+// the path so far, the limits of options, and the loop that raises the bound
+struct IDASearch {
+    const Tables& tables;
+    const SolveOptions& options;
+    std::chrono::steady_clock::time_point startTime;
+    long long explored = 0;
+    bool aborted = false;
+    byte path[64];
+
+    IDASearch(const SolveOptions& options);
+
+    bool expand(); // counts a node; false (and aborted) once the node budget or deadline is reached
+    static bool redundantTurn(const byte* path, int depth, int tid); // tid can be skipped after path[0..depth)
+
+    // deepen: calls searchTo(bound) (a search for a solution of exactly bound moves, written into path)
+    // for bound = h, h + 1, ... until it succeeds, and stores the outcome in result
+    template<typename SearchTo>
+    void deepen(int h, SearchTo searchTo, SolveResult& result) {
+        const int maxDepth = options.maxDepth != -1 ? std::min(options.maxDepth, (int) sizeof(path)) : sizeof(path);
+
+        result.status = SOLVE_ABORTED;
+        for(int bound = h; bound <= maxDepth && !aborted; bound++) {
+            if(!searchTo(bound)) continue;
+
+            result.status = SOLVE_OPTIMAL;
+            result.path.assign(path, path + bound);
+            return;
+        }
+    }
+};
+
+const SolveResult& solveWithTables(SolverContext& context, const PocketCube& startNode, const SolveOptions& options); // IDA* over Tables
+SolveResult solveWithTables(const PocketCube& startNode, const SolveOptions& options); // (with a temporary context)
+int solveStates(SolverContext& context, const short* states, int n, byte* out, int capacity, int* offsets); // many states at once (see tables.cpp)
+int moveDistances(SolverContext& context, const PocketCube& c, int* distances); // distance after each of the 12 turns (see tables.cpp)
+
+/* ~ ~ ~ ~ Masked Goals ~ ~ ~ ~ */
+
+constexpr int MAX_CACHED_GOALS = 8; // goal tables kept (each takes NUM_STATES bytes)
+
+// Goal: a target state in which some stickers don't matter (e.g. "first layer solved"); written as
+// 24 color characters (as in PocketCube::parse), with '?' (or '.') for the stickers that don't matter
+struct Goal {
+    string pattern;           // the normalized text (upper case; '?' for don't-care stickers)
+    unsigned int allowed[8];  // [location]: bit (corner * 3 + twist) is set if that corner fits there with that twist
+
+    static int parse(const string& text, Goal& out); // returns STATE_VALID or STATE_BAD_FORMAT
+    bool matches(const CubieCube& c) const;
+};
+
+// solveToGoal: finds a shortest sequence of turns that takes startNode to any state matching the goal,
+// by IDA* over a table of distances built for the goal (once per goal; the latest MAX_CACHED_GOALS tables
+// are cached). The result is SOLVE_UNSOLVABLE if startNode is invalid or no state matches the goal.
+const SolveResult& solveToGoal(SolverContext& context, const PocketCube& startNode, const Goal& goal,
+                               const SolveOptions& options);
+
+/* ~ ~ ~ ~ Scrambling ~ ~ ~ ~ */
+
+constexpr int MAX_FIXED_DEPTH = 14; // the largest distance of a state with DBL solved (quarter turns)
+
+// Scrambler: samples states (with DBL solved) uniformly at random, and returns the shortest
+// scramble that produces each one
+struct Scrambler {
+    std::mt19937_64 rng;
+
+    Scrambler(unsigned long long seed);
+    int next(byte* scramble, int depth = -1); // writes a scramble (of exactly depth turns, unless -1); returns its length (-1 for a bad depth)
+};
+
+/* ~ ~ ~ ~ Binary Records ~ ~ ~ ~ */
+
+// State files: the magic "PCS1", the record format (4-byte little-endian), then the records.
+const int RECORD_RANK     = 0; // Tables::rank, as a 4-byte little-endian integer
+const int RECORD_STICKERS = 1; // PocketCube::state, as 6 little-endian shorts (12 bytes; any stickers)
+
+// Solution files: the magic "PCM1", then per solution its length (1 byte) followed by its turnIDs,
+// two per byte (low nibble first). A length of UNSOLVED_RECORD marks a state without a solution.
+const byte UNSOLVED_RECORD = 0xFF;
+
+string stateFileHeader(int format);
+string solutionFileHeader();
+bool appendStateRecord(const PocketCube& c, int format, string& out); // false if c can't be ranked
+void appendSolutionRecord(const byte* path, int length, string& out); // (length -1 = unsolved)
+
+// MappedFile: a read-only memory map of an entire file
+class MappedFile {
+public:
+    const byte* data = nullptr;
+    size_t size = 0;
+
+    bool open(const char* path);
+    ~MappedFile();
+};
+
+// StateReader: random access to the records of a (mapped) state file
+class StateReader {
+public:
+    int format;
+    size_t count;          // number of (whole) records
+    bool truncated;        // the file ends with part of a record (which isn't counted)
+
+    bool open(const char* path); // false if the file can't be mapped or isn't a state file
+    bool at(size_t i, PocketCube& out) const; // reads the ith record; false if it isn't a state
+
+private:
+    MappedFile file;
+};
+
+// SolutionReader: sequential access to the records of a (mapped) solution file
+class SolutionReader {
+public:
+    bool open(const char* path);
+    bool truncated = false; // next stopped at a record cut off by the end of the file
+
+    bool next(vector<byte>& path, bool& solved); // reads the next record; false at the end (or if truncated)
+
+private:
+    MappedFile file;
+    size_t position = 4;
+};
+
+// BlockWriter: collects output and writes it in large blocks
+class BlockWriter {
+public:
+    bool open(const char* path); // ("-" = stdout)
+    void write(const string& bytes);
+    bool close(); // flushes; false if any write failed
+    ~BlockWriter();
+
+private:
+    FILE* file = nullptr;
+    string buffer;
+    bool failed = false;
+};
+
+/* ~ ~ ~ ~ Tracing ~ ~ ~ ~ */
+
+// TRACE_SCOPE(name) records the time spent in the enclosing scope as a trace event (name must be
+// a string literal). Builds without -DTRACING compile it away entirely.
+#ifdef TRACING
+constexpr int TRACE_CAPACITY = 1 << 16; // events kept (the oldest are overwritten first)
+
+long long traceNow(); // nanoseconds on the steady clock (performance.now() in the browser)
+void recordTrace(const char* name, long long start, long long end); // lock-free; callable from any thread
+
+struct TraceScope {
+    const char* name;
+    long long start;
+
+    TraceScope(const char* name): name(name), start(traceNow()) { }
+    ~TraceScope() { recordTrace(name, start, traceNow()); }
+};
+
+#define TRACE_JOIN_(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void) 0)
+#endif
+
+// traceJson: the recorded events (oldest first) in Chrome's trace-event format (an empty list
+// without -DTRACING). Events still being recorded by other threads may be missing or torn.
+string traceJson();
 
 /* ~ ~ ~ ~ Debug ~ ~ ~ ~ */
 
@@ -223,9 +624,38 @@ vector<byte> solve(const PocketCube& startNode); // returns a vector of turnIDs
 
 extern PocketCube cubeState;
 
+constexpr int SOLVE_BUFFER_SIZE = 64; // capacity (in moves) of the exported solve buffer
+
+// MemoryLayout: fixed addresses and sizes of every buffer shared with js. The buffers are static,
+// so the pointers never change (even if the heap grows); js only has to rebuild its views when
+// the heap's ArrayBuffer is replaced. Each generation counter is incremented whenever the
+// corresponding buffer's contents change.
+struct MemoryLayout {
+    int *framebuffer;
+    int framebufferSize;  // (in bytes)
+    byte *cubieColors;
+    int cubieColorsSize;  // (in bytes)
+    byte *solveBuffer;
+    int solveBufferSize;  // (in bytes)
+    int frameGeneration;  // incremented when draw() renders a new frame
+    int stateGeneration;  // incremented when cubeState changes
+    int solveGeneration;  // incremented when solveCube() writes a new solution
+    short *stateBuffer;   // staging area for transfering cubeState (see saveState and loadState)
+    int stateBufferSize;  // (in bytes)
+    byte *scrambleBuffer; // written by randomScramble
+    int scrambleBufferSize; // (in bytes)
+    byte *stickerChanges; // written by getStickerChanges
+    int stickerChangesSize; // (in bytes)
+    byte *moveHints;      // written by getMoveHints
+    int moveHintsSize;    // (in bytes)
+};
+
 /* ~ ~ ~ ~ Exported Functions ~ ~ ~ ~ */
 
 extern "C" {
+    /* ~ Memory ~ */
+    MemoryLayout *getMemoryLayout();
+
     /* ~ 3d Graphics ~ */
     int *getImageDataBuffer();
     void draw();
@@ -233,12 +663,23 @@ extern "C" {
 
     /* ~ 2d Graphics */
     byte *getCubieColors();
+    int getStickerChanges();
 
     /* ~ Turning ~ */
     void init();
     void executeTurn(int);
+    void saveState();
+    int loadState();
     int solveCube();
     byte *getSolveBuffer();
+    int solveMany(const short*, int, byte*, int, int*);
+    int getMoveHints();
+    int prepareTables(double);
+    int randomScramble(int);
+
+    /* ~ Tracing ~ */
+    int traceEnabled();
+    const char *exportTrace();
 }
 
 #endif // SOLVER
@@ -1,5 +1,7 @@
 #include "solver.h"
 
+#include <chrono>
+
 /* ~ ~ ~ ~ Solving ~ ~ ~ ~ */
 
 // inverse: given a turn ID, the inverse turn ID is returned.
@@ -27,75 +29,290 @@ PocketCube& turn(PocketCube& c, int turnId) {
     return c; // if turnId is invalid (which shouldn't happen), return c
 }
 
-// explore: given a node (a PocketCube state) and a parent-map, add all 
-// unexplored (without-a-parent) neighboring nodes to the q, making the current
-// state their new parent.
-void explore(const PocketCube& node, unordered_set<PocketCube, PocketCube::hash>& vis, 
-             unordered_map<PocketCube, int, PocketCube::hash>& parents,
-             queue<PocketCube>& q) {
+/* ~ ~ ~ ~ Solver Context ~ ~ ~ ~ */
+
+constexpr size_t MIN_TREE_CAPACITY = 1 << 12;
+
+// reset: starts a new epoch (which empties every table), and empties the queues
+void SolverContext::reset() {
+    if(++epoch == 0) { // (wrapped around: entries from 2^32 epochs ago would look current)
+        for(Tree& tree : trees) for(Entry& entry : tree.entries) entry.epoch = 0;
+        epoch = 1;
+    }
+
+    for(Tree& tree : trees) {
+        if(tree.entries.empty()) tree.entries.resize(MIN_TREE_CAPACITY, Entry{0, 0, NO_MOVE, 0});
+        tree.size = 0;
+        tree.queue.clear();
+        tree.head = 0;
+    }
+}
+
+// slotOf (helper): the preferred slot of key in a table of the given capacity (a power of 2)
+size_t slotOf(uint128_t key, size_t capacity) {
+    unsigned long long h = (unsigned long long) key * 0x9E3779B97F4A7C15ULL ^
+                           (unsigned long long)(key >> 64) * 0xC2B2AE3D27D4EB4FULL;
+    return (h ^ h >> 32) & (capacity - 1);
+}
+
+SolverContext::Entry* SolverContext::find(Tree& tree, uint128_t key) const {
+    const size_t mask = tree.entries.size() - 1;
+
+    for(size_t slot = slotOf(key, mask + 1); tree.entries[slot].epoch == epoch; slot = (slot + 1) & mask) {
+        if(tree.entries[slot].key == key) return &tree.entries[slot];
+    }
+
+    return nullptr;
+}
+
+// insert: adds the entry, doubling the table first if it would become more than half full
+void SolverContext::insert(Tree& tree, uint128_t key, byte move, byte depth) {
+    if(2 * (tree.size + 1) > tree.entries.size()) {
+        vector<Entry> old(tree.entries.size() * 2, Entry{0, 0, NO_MOVE, 0});
+        old.swap(tree.entries);
+        tree.size = 0;
+
+        for(const Entry& entry : old) {
+            if(entry.epoch == epoch) insert(tree, entry.key, entry.move, entry.depth);
+        }
+    }
+
+    const size_t mask = tree.entries.size() - 1;
+    size_t slot = slotOf(key, mask + 1);
+    while(tree.entries[slot].epoch == epoch) slot = (slot + 1) & mask;
+
+    tree.entries[slot] = {key, epoch, move, depth};
+    tree.size++;
+}
+
+// pack: the 6 faces' stickers as one 96-bit key
+uint128_t SolverContext::pack(const PocketCube& c) {
+    uint128_t key = 0;
+    for(const short& face : c.state) key = key << 16 | (unsigned short) face;
+
+    return key;
+}
+
+/* ~ ~ ~ ~ Bidirectional Search ~ ~ ~ ~ */
 
-    vis.insert(node);
+typedef SolverContext::Tree Tree;
+
+// explored states between checks of the deadline (exploring one takes microseconds, so that a
+// time slice overruns by well under a millisecond)
+constexpr long long CLOCK_INTERVAL = 64;
+
+// explore: given a node (a PocketCube state) of the given tree, add all unseen (without-a-parent)
+// neighboring nodes to the tree's queue, making the current state their parent.
+void explore(SolverContext& context, const PocketCube& node, Tree& tree) {
+    const int depth = context.find(tree, SolverContext::pack(node))->depth + 1;
 
     for(int tid = 0; tid < 12; tid++) {        // for each turn-function,
         PocketCube neigh = node;               // execute the function;
         turn(neigh, tid);
 
-        if(parents.find(neigh) != parents.end()) continue;   
+        const uint128_t key = SolverContext::pack(neigh);
+        if(context.find(tree, key) != nullptr) continue;
 
                                                // if the resultant state hasn't been seen,
-        q.push(neigh);                         // add it to the q
-        parents[neigh] = tid;                  // and assign it a parent-move
+        tree.queue.push_back(neigh);           // add it to the queue
+        context.insert(tree, key, tid, depth); // and assign it a parent-move
     }
 }
 
+// pathToRoot (helper): walks from node to the root of the given tree, appending the moves to
+// path in the order they were taken from the root
+void pathToRoot(SolverContext& context, PocketCube node, Tree& tree, vector<byte>& path) {
+    const size_t start = path.size();
 
-// solve: uses meet-in-the-middle-bfs to determine the shortest path from the 
-// current state to the solved state, and returns the corresponding series of moves.
-vector<byte> solve(const PocketCube& startNode) {
+    for(byte move; (move = context.find(tree, SolverContext::pack(node))->move) != SolverContext::NO_MOVE; ) {
+        path.push_back(move);
+        turn(node, inverse(move));
+    }
+
+    std::reverse(path.begin() + start, path.end());
+}
+
+// solvedStickers (helper): counts the stickers that match the solved state
+int solvedStickers(const PocketCube& c) {
+    int count = 0;
+    for(int face = 0; face < 6; face++) {
+        for(int cell = 0; cell < 4; cell++) {
+            count += c.sticker(face, cell) == PocketCube::solved.sticker(face, cell);
+        }
+    }
+
+    return count;
+}
+
+// unpack (helper): the inverse of SolverContext::pack
+PocketCube unpack(uint128_t key) {
+    PocketCube c;
+    for(int face = 5; face >= 0; face--, key >>= 16) c.state[face] = (short)(unsigned short) key;
+
+    return c;
+}
+
+// seedTrees (helper): empties the context's trees, and roots them at startNode and the solved state
+void seedTrees(SolverContext& context, const PocketCube& startNode) {
     PocketCube endNode; // solved state
 
-    unordered_map<PocketCube, int, PocketCube::hash> parents1, parents2; // parent-move mappings for both trees
-    unordered_set<PocketCube, PocketCube::hash> vis1, vis2; // sets of explored nodes for both trees
-    queue<PocketCube> q1, q2; // queues of (potentially) unexplored nodes for both trees
+    context.reset();
+    Tree& tree1 = context.trees[0]; // the unsolved tree
+    Tree& tree2 = context.trees[1]; // the solved tree
 
-    q1.push(startNode);
-    q2.push(endNode);
-    parents1[startNode] = -1;
-    parents2[endNode] = -1;
+    tree1.queue.push_back(startNode);
+    tree2.queue.push_back(endNode);
+    context.insert(tree1, SolverContext::pack(startNode), SolverContext::NO_MOVE, 0);
+    context.insert(tree2, SolverContext::pack(endNode), SolverContext::NO_MOVE, 0);
+}
 
-    PocketCube currentNode; // temporary variable to hold the currently explored node;
-                            // the trees' insersection will be stored here when the while-loop terminates
+// growTrees (helper): explores states alternately from both trees (continuing from their queues)
+// until they meet, leaving the intersection in meeting (SOLVE_OPTIMAL), or one of the limits is
+// reached (SOLVE_IN_PROGRESS), or both trees are exhausted (SOLVE_UNSOLVABLE)
+int growTrees(SolverContext& context, const SolveOptions& options, PocketCube& meeting) {
+    Tree& tree1 = context.trees[0];
+    Tree& tree2 = context.trees[1];
 
+    const auto startTime = std::chrono::steady_clock::now();
+    long long explored = 0;
+
+    // (every state enters a queue once, when it is first seen, so each one is explored at most once)
     while(true) {
+        // (both trees are exhausted only if the state is unreachable, which isSolvable rules out)
+        if(tree1.head == tree1.queue.size() || tree2.head == tree2.queue.size()) return SOLVE_UNSOLVABLE;
+
         // explore one new state from the unsolved tree
-        currentNode = q1.front(); q1.pop();
-        if(parents2.find(currentNode) != parents2.end()) break;
-        if(vis1.find(currentNode) == vis1.end()) explore(currentNode, vis1, parents1, q1);
+        meeting = tree1.queue[tree1.head++];
+        if(context.find(tree2, SolverContext::pack(meeting)) != nullptr) return SOLVE_OPTIMAL;
+        explore(context, meeting, tree1);
 
         // explore one new state from the solved tree
-        currentNode = q2.front(); q2.pop();
-        if(parents1.find(currentNode) != parents1.end()) break;
-        if(vis2.find(currentNode) == vis2.end()) explore(currentNode, vis2, parents2, q2);
+        meeting = tree2.queue[tree2.head++];
+        if(context.find(tree1, SolverContext::pack(meeting)) != nullptr) return SOLVE_OPTIMAL;
+        explore(context, meeting, tree2);
+
+        // check the limits
+        explored += 2;
+        bool limitReached = options.maxNodes != -1 && explored >= options.maxNodes;
+
+        if(!limitReached && options.maxDepth != -1 && tree1.head < tree1.queue.size() && tree2.head < tree2.queue.size()) {
+            limitReached = context.find(tree1, SolverContext::pack(tree1.queue[tree1.head]))->depth +
+                           context.find(tree2, SolverContext::pack(tree2.queue[tree2.head]))->depth > options.maxDepth;
+        }
+
+        if(!limitReached && options.maxTimeMs != -1 && explored % CLOCK_INTERVAL == 0) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+            limitReached = elapsed.count() >= options.maxTimeMs;
+        }
+
+        if(limitReached) return SOLVE_IN_PROGRESS;
     }
+}
 
-    // stich together the path by walking along the solved and unsolved trees
-    vector<byte> solvedPath, unsolvedPath;
-    PocketCube intersection = currentNode;
+// stitchPath (helper): writes the path from the start to the solved state, through meeting (a state
+// in both trees), into path
+void stitchPath(SolverContext& context, const PocketCube& meeting, vector<byte>& path) {
+    pathToRoot(context, meeting, context.trees[0], path); // path from the start to the intersection
+    const size_t middle = path.size();
+    pathToRoot(context, meeting, context.trees[1], path); // path from the solved state to the intersection
 
-    while(parents1[currentNode] != -1) { // unsolved tree
-        unsolvedPath.push_back(parents1[currentNode]);
-        turn(currentNode, inverse(parents1[currentNode]));
+    std::reverse(path.begin() + middle, path.end()); // (add inversed turns, because the
+    for(size_t i = middle; i < path.size(); i++) {   // solved tree is backwards)
+        path[i] = inverse(path[i]);
     }
+}
 
-    currentNode = intersection;
-    while(parents2[currentNode] != -1) { // solved tree
-        solvedPath.push_back(inverse(parents2[currentNode])); // (add inversed turn, because solved tree is backwards)
-        turn(currentNode, inverse(parents2[currentNode]));
+// solve: uses meet-in-the-middle-bfs to determine the shortest path from the 
+// current state to the solved state, and returns the corresponding series of moves.
+// The search stops early if any of the given limits is reached; the result is then
+// the path (within the unsolved tree) to the state with the most solved stickers.
+// The result is stored in (and returned from) the context.
+const SolveResult& solve(SolverContext& context, const PocketCube& startNode, const SolveOptions& options) {
+    TRACE_SCOPE("solve");
+    SolveResult& result = context.result;
+    result.path.clear();
+
+    if(!startNode.isSolvable()) {
+        result.status = SOLVE_UNSOLVABLE;
+        return result;
     }
 
-    // path = the entire solved path
-    vector<byte> path(unsolvedPath.rbegin(), unsolvedPath.rend()); // path = { reverse(unsolvedPath} }
-    path.insert(path.end(), solvedPath.begin(), solvedPath.end()); // path += solvedPath
+    seedTrees(context, startNode);
+
+    PocketCube meeting; // the trees' intersection, once they meet
+    result.status = growTrees(context, options, meeting);
+
+    if(result.status == SOLVE_OPTIMAL) stitchPath(context, meeting, result.path);
+    if(result.status != SOLVE_IN_PROGRESS) return result;
+
+    // a limit was reached: return the path to the most-solved state seen so far (if it improves on the start)
+    const SolverContext::Entry* best = nullptr;
+    int bestSolved = solvedStickers(startNode);
+    for(const SolverContext::Entry& entry : context.trees[0].entries) {
+        if(entry.epoch != context.epoch || (options.maxDepth != -1 && entry.depth > options.maxDepth)) continue;
+
+        int entrySolved = solvedStickers(unpack(entry.key));
+        if(entrySolved > bestSolved) {
+            best = &entry;
+            bestSolved = entrySolved;
+        }
+    }
 
-    return path;
+    if(best == nullptr) {
+        result.status = SOLVE_ABORTED;
+        return result;
+    }
+
+    pathToRoot(context, unpack(best->key), context.trees[0], result.path);
+    result.status = SOLVE_BEST_SO_FAR;
+    return result;
+}
+
+/* ~ ~ ~ ~ Resumable Search ~ ~ ~ ~ */
+
+// startSolve: begins a solve of startNode that resumeSolve carries out a slice at a time; the
+// context holds the search (both trees and their queues) in between. Any other solve with the
+// context ends it.
+const SolveResult& startSolve(SolverContext& context, const PocketCube& startNode) {
+    SolveResult& result = context.result;
+    result.path.clear();
+
+    if(!startNode.isSolvable()) {
+        result.status = SOLVE_UNSOLVABLE;
+        return result;
+    }
+
+    seedTrees(context, startNode);
+    result.status = SOLVE_IN_PROGRESS;
+    return result;
+}
+
+// resumeSolve: continues the context's solve until it finishes (with the same results as an
+// unbounded solve()) or one of the slice's limits is reached (the status then stays
+// SOLVE_IN_PROGRESS); slice.maxDepth is ignored. Does nothing (and returns the context's last result)
+// if no solve is in progress, e.g. on a fresh context, before any startSolve.
+const SolveResult& resumeSolve(SolverContext& context, const SolveOptions& slice) {
+    TRACE_SCOPE("resumeSolve");
+    SolveResult& result = context.result;
+    if(result.status != SOLVE_IN_PROGRESS) return result;
+
+    SolveOptions limits = slice;
+    limits.maxDepth = -1;
+
+    PocketCube meeting;
+    result.status = growTrees(context, limits, meeting);
+    if(result.status == SOLVE_OPTIMAL) stitchPath(context, meeting, result.path);
+
+    return result;
+}
+
+SolveResult solve(const PocketCube& startNode, const SolveOptions& options) {
+    SolverContext context;
+    return solve(context, startNode, options);
+}
+
+// solve (unbounded): returns the shortest series of moves that solves startNode (or an empty
+// vector if startNode is unsolvable)
+vector<byte> solve(const PocketCube& startNode) {
+    return solve(startNode, SolveOptions{}).path;
 }
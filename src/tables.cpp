@@ -0,0 +1,522 @@
+#include "solver.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+/* ~ ~ ~ ~ Cubie Maps ~ ~ ~ ~ */
+
+// apply: returns the result of applying *this to c
+CubieCube CubieMap::apply(const CubieCube& c) const {
+    CubieCube result;
+    for(int location = 0; location < 8; location++) {
+        result.corners[location] = c.corners[from[location]];
+        result.twists[location] = (c.twists[from[location]] + delta[location]) % 3;
+    }
+
+    return result;
+}
+
+// of: returns the effect of the sticker permutation on the cubie form (p must move whole
+// corners, keeping their stickers in clockwise order, as turns and rotations do)
+CubieMap CubieMap::of(const Permutation& p) {
+    CubieMap map;
+
+    for(int location = 0; location < 8; location++) {
+        const byte* facelet = cornerFacelets[location][0];
+        const int source = p.from[facelet[0] * 4 + facelet[1]];
+
+        // find the corner location (and index within it) that the U/D-facelet's sticker came from
+        for(int l = 0; l < 8; l++) {
+            for(int i = 0; i < 3; i++) {
+                if(cornerFacelets[l][i][0] * 4 + cornerFacelets[l][i][1] != source) continue;
+                map.from[location] = l;
+                map.delta[location] = (3 - i) % 3;
+            }
+        }
+    }
+
+    return map;
+}
+
+// ofTurns: returns the cubie map of the given sequence of turnIDs
+CubieMap CubieMap::ofTurns(const vector<byte>& turns) {
+    return of(Permutation::ofTurns(turns));
+}
+
+/* ~ ~ ~ ~ Coordinates ~ ~ ~ ~ */
+
+// the corner locations (and corner IDs) other than DBL, in coordinate order
+const byte MOVABLE[7] = {UFR, UFL, UBL, UBR, DFR, DFL, DBR};
+
+const int FACTORIALS[8] = {1, 1, 2, 6, 24, 120, 720, 5040};
+
+// encode: returns the coordinate of c (perm * NUM_TWISTS + twist); DBL must be solved.
+// perm is the Lehmer-code rank of the 7 movable corners, twist is the first 6 twists in base 3.
+int Tables::encode(const CubieCube& c) {
+    int perm = 0, twist = 0;
+
+    for(int i = 0; i < 7; i++) {
+        int smaller = 0;
+        for(int j = i + 1; j < 7; j++) smaller += c.corners[MOVABLE[j]] < c.corners[MOVABLE[i]];
+        perm += smaller * FACTORIALS[6 - i];
+    }
+
+    for(int i = 5; i >= 0; i--) twist = twist * 3 + c.twists[MOVABLE[i]];
+
+    return perm * NUM_TWISTS + twist;
+}
+
+// decode: returns the cubie form of the given coordinate
+CubieCube Tables::decode(int index) {
+    CubieCube c;
+    int perm = index / NUM_TWISTS, twist = index % NUM_TWISTS;
+
+    bool used[7] = {false};
+    for(int i = 0; i < 7; i++) {
+        int smaller = perm / FACTORIALS[6 - i];
+        perm %= FACTORIALS[6 - i];
+
+        int k = 0; // the (smaller)th unused corner
+        for(; used[k] || smaller > 0; k++) if(!used[k]) smaller--;
+        used[k] = true;
+        c.corners[MOVABLE[i]] = MOVABLE[k];
+    }
+
+    int twistSum = 0;
+    for(int i = 0; i < 6; i++) {
+        c.twists[MOVABLE[i]] = twist % 3;
+        twistSum += twist % 3;
+        twist /= 3;
+    }
+
+    c.twists[MOVABLE[6]] = (3 - twistSum % 3) % 3;
+    c.corners[DBL] = DBL;
+    c.twists[DBL] = 0;
+
+    return c;
+}
+
+/* ~ ~ ~ ~ Tables ~ ~ ~ ~ */
+
+// constructor: derives the cubie maps from the turn methods and fills the move tables (the
+// distance table is filled by the TableLoader)
+Tables::Tables() {
+    TRACE_SCOPE("Tables::Tables");
+    for(int tid = 0; tid < 12; tid++) turns[tid] = CubieMap::ofTurns({(byte) tid});
+
+    // whole-cube rotations: x = R L', y = U D', z = F B' (and all their products)
+    const Permutation axes[3] = {Permutation::ofTurns({TURN_R, TURN_LP}),
+                                 Permutation::ofTurns({TURN_U, TURN_DP}),
+                                 Permutation::ofTurns({TURN_F, TURN_BP})};
+    vector<Permutation> group = {Permutation()};
+
+    for(size_t r = 0; r < group.size(); r++) {
+        for(const Permutation& axis : axes) {
+            Permutation product = group[r].then(axis);
+            if(std::find(group.begin(), group.end(), product) == group.end()) group.push_back(product);
+        }
+    }
+
+    // canonicalizers: the inverse of each rotation, indexed by where the rotation takes DBL
+    for(const Permutation& rotation : group) {
+        CubieCube rotated = CubieMap::of(rotation).apply(decode(0));
+        int l = std::find(rotated.corners, rotated.corners + 8, DBL) - rotated.corners;
+        canonicalizers[l * 3 + rotated.twists[l]] = CubieMap::of(rotation.inverse());
+        rotations[l * 3 + rotated.twists[l]] = CubieMap::of(rotation);
+    }
+
+    // move tables
+    for(int m = 0; m < 6; m++) {
+        const CubieMap& map = turns[FIXED_TURNS[m]];
+        for(int perm = 0; perm < NUM_PERMS; perm++) {
+            permMoves[perm][m] = encode(map.apply(decode(perm * NUM_TWISTS))) / NUM_TWISTS;
+        }
+        for(int twist = 0; twist < NUM_TWISTS; twist++) {
+            twistMoves[twist][m] = encode(map.apply(decode(twist))) % NUM_TWISTS;
+        }
+    }
+}
+
+/* ~ ~ ~ ~ Table Loading ~ ~ ~ ~ */
+
+constexpr int BFS_CHUNK_SIZE = 1 << 16;      // coordinates scanned per step of the breadth-first search
+constexpr int EXPAND_CHUNK_SIZE = 1 << 15;   // groups (of COMPRESSED_GROUP_STATES) expanded per step
+constexpr int COMPRESSED_GROUP_STATES = 20;  // states per group: 4 base-243 bytes (5 distances mod 3 each),
+                                             // which expand to 5 bytes of the distance table
+
+// TableLoader: fills the process-wide tables one step at a time, either by a breadth-first search
+// from the solved coordinate (0), or (in EMBEDDED_TABLES builds) by expanding the compressed
+// distance table embedded in the binary (see writeCompressedTables)
+struct TableLoader {
+    enum Stage {SEARCH, PACK, EXPAND, DONE};
+
+    std::mutex mutex;
+    std::atomic<const Tables*> ready{nullptr}; // set once every step is done
+    Tables tables;
+    Stage stage = SEARCH;
+
+    vector<byte> depths; // (SEARCH/PACK) depth of every coordinate, or 0xFF if not yet found
+    int depth = 0;       // (SEARCH) layer being expanded
+    int found = 0;       // (SEARCH) coordinates found in the next layer so far
+    vector<byte> compressed; // (EXPAND) the embedded table
+    int next = 0;        // first coordinate (or group) of the next step
+
+    TableLoader();
+    void step(); // does one chunk of work
+};
+
+// readCompressedTables (helper): reads the file written by writeCompressedTables; returns false
+// if it is missing or doesn't match this build
+bool readCompressedTables(const char* path, vector<byte>& compressed) {
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr) return false;
+
+    byte header[8];
+    compressed.resize(NUM_STATES / COMPRESSED_GROUP_STATES * 4);
+    bool valid = fread(header, 1, 8, file) == 8 && !memcmp(header, "PCT1", 4) &&
+                 (header[4] | header[5] << 8 | header[6] << 16 | header[7] << 24) == NUM_STATES &&
+                 fread(compressed.data(), 1, compressed.size(), file) == compressed.size();
+    fclose(file);
+
+    if(!valid) compressed.clear();
+    return valid;
+}
+
+TableLoader::TableLoader() {
+    tables.distances.assign(NUM_STATES / 4, 0);
+
+#ifdef EMBEDDED_TABLES
+    if(readCompressedTables(EMBEDDED_TABLES, compressed)) {
+        stage = EXPAND;
+        return;
+    }
+#endif
+
+    depths.assign(NUM_STATES, 0xFF);
+    depths[0] = 0;
+}
+
+void TableLoader::step() {
+    TRACE_SCOPE("TableLoader::step");
+
+    switch(stage) {
+        case SEARCH: { // (one layer at a time, in a byte per state)
+            const int end = std::min(NUM_STATES, next + BFS_CHUNK_SIZE);
+            for(int index = next; index < end; index++) {
+                if(depths[index] != depth) continue;
+
+                for(int m = 0; m < 6; m++) {
+                    int neigh = tables.move(index, m);
+                    if(depths[neigh] != 0xFF) continue;
+                    depths[neigh] = depth + 1;
+                    found++;
+                }
+            }
+
+            next = end;
+            if(next < NUM_STATES) return;
+
+            next = 0;
+            depth++;
+            if(found == 0) stage = PACK;
+            found = 0;
+            return;
+        }
+
+        case PACK: { // (to 2 bits per state)
+            const int end = std::min(NUM_STATES, next + BFS_CHUNK_SIZE);
+            for(int index = next; index < end; index++) {
+                tables.distances[index >> 2] |= (depths[index] % 3) << 2 * (index & 3);
+            }
+
+            next = end;
+            if(next < NUM_STATES) return;
+
+            vector<byte>().swap(depths);
+            stage = DONE;
+            return;
+        }
+
+        case EXPAND: {
+            // expansions[v]: the 5 distances (mod 3) of base-243 byte v, at 2 bits each
+            static const std::array<unsigned short, 243> expansions = []() {
+                std::array<unsigned short, 243> expansions;
+                for(int v = 0; v < 243; v++) {
+                    expansions[v] = 0;
+                    for(int k = 0, rest = v; k < 5; k++, rest /= 3) expansions[v] |= (rest % 3) << 2 * k;
+                }
+                return expansions;
+            }();
+
+            const int numGroups = NUM_STATES / COMPRESSED_GROUP_STATES;
+            const int end = std::min(numGroups, next + EXPAND_CHUNK_SIZE);
+
+            for(int group = next; group < end; group++) {
+                unsigned long long bits = 0;
+                for(int k = 0; k < 4; k++) bits |= (unsigned long long) expansions[compressed[group * 4 + k]] << 10 * k;
+                for(int k = 0; k < 5; k++) tables.distances[group * 5 + k] = bits >> 8 * k;
+            }
+
+            next = end;
+            if(next < numGroups) return;
+
+            vector<byte>().swap(compressed);
+            stage = DONE;
+            return;
+        }
+
+        case DONE:
+            return;
+    }
+}
+
+// loader (helper): the process-wide loader (its constructor builds the move tables)
+TableLoader& loader() {
+    static TableLoader loader;
+    return loader;
+}
+
+// get: returns the process-wide tables, finishing any steps that prepare() hasn't done yet
+const Tables& Tables::get() {
+    static TableLoader& tableLoader = loader();
+    if(const Tables* tables = tableLoader.ready.load(std::memory_order_acquire)) return *tables;
+
+    std::lock_guard<std::mutex> lock(tableLoader.mutex);
+    while(tableLoader.stage != TableLoader::DONE) tableLoader.step();
+    tableLoader.ready.store(&tableLoader.tables, std::memory_order_release);
+
+    return tableLoader.tables;
+}
+
+// prepare: does steps toward the tables until about budgetMs have passed (at least one step);
+// returns whether they are ready
+bool Tables::prepare(double budgetMs) {
+    const auto startTime = std::chrono::steady_clock::now(); // (including the loader's construction)
+    TableLoader& tableLoader = loader();
+    if(tableLoader.ready.load(std::memory_order_acquire) != nullptr) return true;
+
+    std::lock_guard<std::mutex> lock(tableLoader.mutex);
+
+    while(tableLoader.stage != TableLoader::DONE) {
+        tableLoader.step();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        if(elapsed.count() >= budgetMs) break;
+    }
+
+    if(tableLoader.stage != TableLoader::DONE) return false;
+
+    tableLoader.ready.store(&tableLoader.tables, std::memory_order_release);
+    return true;
+}
+
+// writeCompressedTables: writes the distance table as "PCT1", NUM_STATES (4-byte little-endian),
+// then the distances mod 3 in base 243 (5 per byte; the first in the lowest digit)
+bool writeCompressedTables(const char* path) {
+    const Tables& tables = Tables::get();
+    string out = "PCT1";
+    for(int i = 0; i < 4; i++) out.push_back((char)(NUM_STATES >> 8 * i));
+
+    for(int index = 0; index < NUM_STATES; index += 5) {
+        int value = 0;
+        for(int k = 4; k >= 0; k--) value = value * 3 + tables.distanceMod3(index + k);
+        out.push_back((char) value);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if(file == nullptr) return false;
+
+    bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && written;
+}
+
+// move: applies FIXED_TURNS[fixedTurn] to the given coordinate
+int Tables::move(int index, int fixedTurn) const {
+    return permMoves[index / NUM_TWISTS][fixedTurn] * NUM_TWISTS + twistMoves[index % NUM_TWISTS][fixedTurn];
+}
+
+int Tables::distanceMod3(int index) const {
+    return (distances[index >> 2] >> 2 * (index & 3)) & 0b11;
+}
+
+// descend: follows turns whose distance is one less (mod 3) until reaching the solved coordinate,
+// writing the turnIDs into path (if it isn't null), and returns the number of turns (the distance)
+int Tables::descend(int index, byte* path) const {
+    int depth = 0;
+
+    while(index != 0) {
+        const int target = (distanceMod3(index) + 2) % 3;
+        for(int m = 0; m < 6; m++) {
+            int neigh = move(index, m);
+            if(distanceMod3(neigh) != target) continue;
+            if(path != nullptr) path[depth] = FIXED_TURNS[m];
+            index = neigh;
+            break;
+        }
+        depth++;
+    }
+
+    return depth;
+}
+
+int Tables::distance(int index) const {
+    return descend(index, nullptr);
+}
+
+// canonicalIndex: returns the coordinate of c after the whole-cube rotation that solves DBL
+int Tables::canonicalIndex(const CubieCube& c) const {
+    const int l = std::find(c.corners, c.corners + 8, DBL) - c.corners;
+    return encode(canonicalizers[l * 3 + c.twists[l]].apply(c));
+}
+
+// rank: numbers every state (in every orientation) by the rotation that solves DBL, and the
+// coordinate it rotates to
+unsigned int Tables::rank(const CubieCube& c) const {
+    const int l = std::find(c.corners, c.corners + 8, DBL) - c.corners;
+    return (unsigned int)(l * 3 + c.twists[l]) * NUM_STATES + encode(canonicalizers[l * 3 + c.twists[l]].apply(c));
+}
+
+CubieCube Tables::unrank(unsigned int rank) const {
+    return rotations[rank / NUM_STATES].apply(decode(rank % NUM_STATES));
+}
+
+/* ~ ~ ~ ~ Table Solving ~ ~ ~ ~ */
+
+IDASearch::IDASearch(const SolveOptions& options): tables(Tables::get()), options(options),
+                                                    startTime(std::chrono::steady_clock::now()) { }
+
+// expand: counts a node, and checks the node budget and (every 1024 nodes) the deadline
+bool IDASearch::expand() {
+    explored++;
+    if(options.maxNodes != -1 && explored >= options.maxNodes) aborted = true;
+    else if(options.maxTimeMs != -1 && explored % 1024 == 0) {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        aborted = elapsed.count() >= options.maxTimeMs;
+    }
+
+    return !aborted;
+}
+
+// redundantTurn: checks whether tid, following path[0..depth), leads to a state that a shorter (or
+// an equal but preferred) sequence also reaches
+bool IDASearch::redundantTurn(const byte* path, int depth, int tid) {
+    if(depth == 0) return false;
+
+    const byte last = path[depth - 1];
+    if(tid == inverse(last)) return true; // undoes the last turn
+    if(depth > 1 && tid == last && tid == path[depth - 2]) return true; // three equal turns: one inverse turn
+    return oppositeFaces[tid % 6] == last % 6 && tid % 6 < last % 6; // opposite faces commute: fix their order
+}
+
+// TableSearch: iterative-deepening A* over all 12 turns, using the distance of the canonical
+// coordinate as the heuristic. The heuristic changes by at most 1 per turn, so each child's
+// exact value is recovered from its parent's value and the child's distance mod 3.
+struct TableSearch : IDASearch {
+    TableSearch(const SolveOptions& options): IDASearch(options) { }
+
+    static bool isSolved(const CubieCube& c) {
+        for(int location = 0; location < 8; location++) {
+            if(c.corners[location] != location || c.twists[location] != 0) return false;
+        }
+        return true;
+    }
+
+    // search: depth-first search for a solution of exactly depth moves (depth = number of moves
+    // so far, bound = maximum number of moves, h = heuristic of c)
+    bool search(const CubieCube& c, int depth, int bound, int h) {
+        if(isSolved(c)) return depth == bound;
+        if(depth + h > bound || aborted || !expand()) return false;
+
+        for(int tid = 0; tid < 12; tid++) {
+            if(redundantTurn(path, depth, tid)) continue;
+
+            const CubieCube child = tables.turns[tid].apply(c);
+            const int mod = tables.distanceMod3(tables.canonicalIndex(child));
+
+            path[depth] = tid;
+            if(search(child, depth + 1, bound, h + (mod - h % 3 + 4) % 3 - 1)) return true;
+        }
+
+        return false;
+    }
+};
+
+// solveWithTables: finds a shortest solution of startNode by IDA* over the tables (which are
+// built on the first call), and stores it in the context. The limits in options are respected as
+// in solve(), except that no best-so-far path is kept.
+const SolveResult& solveWithTables(SolverContext& context, const PocketCube& startNode, const SolveOptions& options) {
+    TRACE_SCOPE("solveWithTables");
+    SolveResult& result = context.result;
+    result.path.clear();
+
+    CubieCube start;
+    if(startNode.toCubies(start) != STATE_VALID) {
+        result.status = SOLVE_UNSOLVABLE;
+        return result;
+    }
+
+    TableSearch search(options);
+    const int h = search.tables.distance(search.tables.canonicalIndex(start));
+    search.deepen(h, [&](int bound) { return search.search(start, 0, bound, h); }, result);
+
+    return result;
+}
+
+SolveResult solveWithTables(const PocketCube& startNode, const SolveOptions& options) {
+    SolverContext context;
+    return solveWithTables(context, startNode, options);
+}
+
+// solveStates: solves states (n of them, each 6 shorts as in PocketCube::state) one after another,
+// writing solution i into out[offsets[i] .. offsets[i + 1]) (so offsets needs n + 1 entries). An
+// invalid state's solution is the single byte UNSOLVED_RECORD. Stops before the first solution
+// that doesn't fit in capacity bytes; returns the number of states solved.
+int solveStates(SolverContext& context, const short* states, int n, byte* out, int capacity, int* offsets) {
+    TRACE_SCOPE("solveStates");
+    int size = 0;
+    offsets[0] = 0;
+
+    for(int i = 0; i < n; i++) {
+        PocketCube c;
+        std::copy(states + i * 6, states + i * 6 + 6, c.state.begin());
+
+        const SolveResult& result = solveWithTables(context, c, SolveOptions{});
+        const bool solved = result.status == SOLVE_OPTIMAL;
+        const int length = solved ? result.path.size() : 1;
+        if(size + length > capacity) return i;
+
+        if(solved) std::copy(result.path.begin(), result.path.end(), out + size);
+        else out[size] = UNSOLVED_RECORD;
+
+        size += length;
+        offsets[i + 1] = size;
+    }
+
+    return n;
+}
+
+// moveDistances: writes the distance of the state reached by each turn (as solveWithTables counts
+// it) into distances[turnID], and returns the distance of c itself (-1 if c is invalid). Every
+// quarter turn changes the parity of the corners' permutation, so it changes the distance by
+// exactly one: one search bounded by distance - 1 per turn tells the two cases apart.
+int moveDistances(SolverContext& context, const PocketCube& c, int* distances) {
+    TRACE_SCOPE("moveDistances");
+    const SolveResult& result = solveWithTables(context, c, SolveOptions{});
+    if(result.status != SOLVE_OPTIMAL) return -1;
+
+    const int distance = result.path.size();
+    SolveOptions closer;
+    closer.maxDepth = distance - 1;
+
+    for(int tid = 0; tid < 12; tid++) {
+        PocketCube next = c;
+        turn(next, tid);
+
+        const bool isCloser = distance > 0 && solveWithTables(context, next, closer).status == SOLVE_OPTIMAL;
+        distances[tid] = isCloser ? distance - 1 : distance + 1;
+    }
+
+    return distance;
+}
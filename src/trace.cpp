@@ -0,0 +1,66 @@
+#include "solver.h"
+
+#include <atomic>
+#include <chrono>
+
+/* ~ ~ ~ ~ Tracing ~ ~ ~ ~ */
+
+#ifdef TRACING
+struct TraceEvent {
+    const char* name;
+    unsigned int thread;
+    long long start;    // (ns)
+    long long duration; // (ns)
+};
+
+// a ring buffer: every event claims the next slot with a single atomic increment
+TraceEvent traceEvents[TRACE_CAPACITY];
+std::atomic<unsigned long long> traceHead(0);
+std::atomic<unsigned int> traceThreads(0);
+
+long long traceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void recordTrace(const char* name, long long start, long long end) {
+    thread_local const unsigned int thread = traceThreads.fetch_add(1, std::memory_order_relaxed);
+
+    const unsigned long long slot = traceHead.fetch_add(1, std::memory_order_relaxed) % TRACE_CAPACITY;
+    traceEvents[slot] = {name, thread, start, end - start};
+}
+#endif
+
+string traceJson() {
+    string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+#ifdef TRACING
+    const unsigned long long head = traceHead.load(std::memory_order_acquire);
+    char event[256];
+
+    for(unsigned long long i = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0; i < head; i++) {
+        const TraceEvent& e = traceEvents[i % TRACE_CAPACITY];
+        snprintf(event, sizeof(event), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                 json.back() == '[' ? "" : ",", e.name, e.thread, e.start / 1e3, e.duration / 1e3);
+        json += event;
+    }
+#endif
+
+    return json + "]}";
+}
+
+// traceEnabled: whether the module was built with -DTRACING
+int traceEnabled() {
+#ifdef TRACING
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// exportTrace: returns traceJson() as a null-terminated string (valid until the next call)
+const char *exportTrace() {
+    static string json;
+    json = traceJson();
+
+    return json.c_str();
+}
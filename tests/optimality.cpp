@@ -0,0 +1,36 @@
+#include "../src/solver.h"
+
+#include <cstdio>
+
+/*
+ * optimality: checks that solveWithTables (IDA* over the tables) finds solutions exactly as long
+ * as the bidirectional search of solve(), on random states (with a fixed seed). Run by "make test".
+ */
+
+constexpr int NUM_TEST_STATES = 200;
+
+int main() {
+    std::mt19937 rng(2024);
+    SolverContext context;
+    int failures = 0;
+
+    for(int i = 0; i < NUM_TEST_STATES; i++) {
+        PocketCube c;
+        const int scrambleLength = rng() % 25;
+        for(int k = 0; k < scrambleLength; k++) turn(c, rng() % 12);
+
+        const vector<byte> expected = solve(c);
+        const SolveResult& result = solveWithTables(context, c, SolveOptions{});
+
+        PocketCube solved = c;
+        for(const byte& tid : result.path) turn(solved, tid);
+
+        if(result.status != SOLVE_OPTIMAL || solved != PocketCube::solved || result.path.size() != expected.size()) {
+            printf("FAIL %s: %zu moves (solve() finds %zu)\n", c.toString().c_str(), result.path.size(), expected.size());
+            failures++;
+        }
+    }
+
+    printf("optimality: %d of %d states failed\n", failures, NUM_TEST_STATES);
+    return failures == 0 ? 0 : 1;
+}
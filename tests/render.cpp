@@ -0,0 +1,73 @@
+#include "../src/solver.h"
+
+#include <cstdio>
+
+/*
+ * render: checks that the vectorized ray-caster (RayKernel) draws exactly the pixels of the scalar
+ * reference path (one POV::rectRaycast per pixel per face, as draw() does under SCALAR_RENDERER),
+ * over random turns and rotations (with a fixed seed). Run by "make test".
+ */
+
+constexpr int WIDTH = 300;
+constexpr int HEIGHT = 300;
+constexpr int NUM_TEST_FRAMES = 50;
+
+PocketCube cubeState; // (read by Cube::updateCubieColors)
+
+// renderScalar (helper): the reference path
+void renderScalar(const POV& pov, const vector<Rect>& faces, int* buffer) {
+    Point collision;
+
+    for(int i = 0; i < HEIGHT; i++) {
+        for(int j = 0; j < WIDTH; j++) {
+            double color = WHITE_RGBA;
+            double bestZ = 1e10; // z-value of point closest to the viewpoint
+            for(int f = 0; f < faces.size(); f++) {
+                collision = pov.rectRaycast(faces[f], j, HEIGHT - i - 1);
+
+                if(collision == Point::notAPoint) continue;
+                if(collision.z < bestZ) {
+                    bestZ = collision.z;
+                    color = collision.color;
+                }
+            }
+
+            buffer[i * WIDTH + j] = color;
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(2024);
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    POV pov(WIDTH, HEIGHT, 300, 3000);
+    Cube cube(-100, -100, -100, 200);
+    vector<int> expected(WIDTH * HEIGHT), actual(WIDTH * HEIGHT);
+    int failures = 0;
+
+    cubeState = PocketCube::solved;
+    for(int frame = 0; frame < NUM_TEST_FRAMES; frame++) {
+        turn(cubeState, rng() % 12);
+        const double xRotRad = angle(rng), yRotRad = angle(rng);
+
+        Cube::updateCubieColors();
+        const vector<Rect> faces = cube.rotate(xRotRad, yRotRad).getFaces();
+
+        renderScalar(pov, faces, expected.data());
+
+        RayKernel kernel(pov, faces);
+        for(int i = 0; i < HEIGHT; i++) kernel.renderRow(actual.data() + i * WIDTH, WIDTH, HEIGHT - i - 1);
+
+        int differences = 0;
+        for(int k = 0; k < WIDTH * HEIGHT; k++) differences += expected[k] != actual[k];
+
+        if(differences > 0) {
+            printf("FAIL frame %d (rotation %f, %f): %d of %d pixels differ\n", frame, xRotRad, yRotRad,
+                   differences, WIDTH * HEIGHT);
+            failures++;
+        }
+    }
+
+    printf("render: %d of %d frames differed\n", failures, NUM_TEST_FRAMES);
+    return failures == 0 ? 0 : 1;
+}